@@ -0,0 +1,87 @@
+// bench\benchUtils.hpp
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// shared helpers for the micro-benchmarks, nothing here is part of the compiler
+
+// runs fn `reps` times and returns the fastest run in seconds (the least disturbed one)
+template <typename Fn>
+double bestOf( const int reps, Fn&& fn )
+{
+	double best = 1e300;
+	for ( int i = 0; i < reps; ++i ) {
+		const auto start = std::chrono::steady_clock::now();
+		fn();
+		const std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+		best = std::min( best, took.count() );
+	}
+	return best;
+}
+
+inline void reportThroughput( const char* label, const size_t bytes, const double seconds )
+{
+	std::printf( "%-28s %9.3f ms  %9.1f MB/s\n", label, seconds * 1e3,
+					 static_cast<double>( bytes ) / seconds / ( 1024.0 * 1024.0 ) );
+}
+
+// keeps the optimiser from deleting work whose result is never used
+template <typename T>
+void doNotOptimise( const T& value )
+{
+#if defined( __GNUC__ ) || defined( __clang__ )
+	asm volatile( "" : : "g"( &value ) : "memory" );
+#else
+	static volatile const void* sink;
+	sink = &value;
+#endif
+}
+
+// a valid Carp program of roughly `bytes` bytes, heavy on comments and whitespace like our
+// generated sources
+inline std::string makeCarpSource( const size_t bytes )
+{
+	static const char* const chunk = "// --- generated block, do not edit -------------------------\n"
+												"/* the values below come from the template layer and are\n"
+												"   kept around for debugging the generator */\n"
+												"int counter_value = 12345 + 678 * 9;\n"
+												"string message_text = \"hello from the generator\";\n"
+												"\n"
+												"if ( counter_value > 10 ) {\n"
+												"      counter_value = counter_value - 1;   // count down\n"
+												"}\n"
+												"\n";
+	std::string src;
+	src.reserve( bytes + 512 );
+	int block = 0;
+	while ( src.size() < bytes ) {
+		// every block declares its own names so the program stays semantically valid
+		std::string text = chunk;
+		const std::string suffix = std::to_string( block++ );
+		for ( const char* name : { "counter_value", "message_text" } ) {
+			for ( size_t at = text.find( name ); at != std::string::npos;
+					at = text.find( name, at + 1 ) ) {
+				text.insert( at + std::char_traits<char>::length( name ), suffix );
+			}
+		}
+		src += text;
+	}
+	return src;
+}
+
+// roughly `bytes` of operator-dense code with hardly any comments or padding, to stress the
+// per-token work rather than the skipping
+inline std::string makeDenseCarpSource( const size_t bytes )
+{
+	std::string src;
+	src.reserve( bytes + 256 );
+	for ( int i = 0; src.size() < bytes; ++i ) {
+		const std::string n = std::to_string( i );
+		src += "int a" + n + "=(" + n + "+b*3)-c/7;if(a" + n + ">=b){b=b+1;}while(a" + n +
+				 "!=c){c=c-1;}x=x==y;\n";
+	}
+	return src;
+}
@@ -0,0 +1,82 @@
+// bench\cacheBench.cpp
+// Startup on a large generated program: a cold compile (lex + parse + check) against a .carpc
+// cache hit (hash the source + load the cache). Both start from the file on disk.
+// usage: CarpBenchCache [megabytes]
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "../src/headers/SemanticAnalyser.hpp"
+#include "../src/headers/astCache.hpp"
+#include "../src/headers/flatAst.hpp"
+#include "../src/headers/sourceFile.hpp"
+#include "../src/headers/tokeniser.hpp"
+#include "benchUtils.hpp"
+
+int main( int argc, char* argv[] )
+{
+	const size_t megabytes = argc > 1 ? std::strtoul( argv[ 1 ], nullptr, 10 ) : 16;
+	const auto dir = std::filesystem::temp_directory_path();
+	const std::string sourcePath = ( dir / "carpBenchCache.carp" ).string();
+	const std::string cachePath = sourcePath + "c";
+	{
+		std::ofstream out( sourcePath, std::ios::binary | std::ios::trunc );
+		out << makeCarpSource( megabytes * 1024 * 1024 );
+	}
+
+	// what every run without a cache pays
+	size_t sourceBytes = 0;
+	size_t nodes = 0;
+	const double coldSeconds = bestOf( 5, [ & ] {
+		const SourceFile file = SourceFile::load( sourcePath );
+		const std::string_view source = file.text();
+		Interner interner;
+		Tokeniser tokeniser( source, interner );
+		const std::vector<Token> tokens = tokeniser.tokenise();
+		FlatAst ast;
+		FlatParser parser( tokens, ast );
+		parser.parse();
+		const LineTable lines( source );
+		SemanticAnalyser analyser( lines );
+		analyser.analyse( ast );
+		sourceBytes = source.size();
+		nodes = ast.size();
+	} );
+
+	// written once, after a clean compile
+	double saveSeconds = 0;
+	{
+		const SourceFile file = SourceFile::load( sourcePath );
+		Interner interner;
+		Tokeniser tokeniser( file.text(), interner );
+		FlatAst ast;
+		FlatParser parser( tokeniser, ast );
+		parser.parse();
+		saveSeconds = bestOf( 5, [ & ] { astcache::save( cachePath, file.text(), ast ); } );
+	}
+
+	// what a run on an unchanged file pays
+	bool hit = false;
+	const double hitSeconds = bestOf( 5, [ & ] {
+		const SourceFile file = SourceFile::load( sourcePath );
+		FlatAst ast;
+		hit = astcache::load( cachePath, file.text(), ast );
+		doNotOptimise( ast );
+	} );
+
+	std::printf( "\ncomment-heavy input: %zu bytes, %zu nodes, cache %ju bytes\n", sourceBytes,
+					 nodes, static_cast<uintmax_t>( std::filesystem::file_size( cachePath ) ) );
+	reportThroughput( "cold compile", sourceBytes, coldSeconds );
+	reportThroughput( "cache hit", sourceBytes, hitSeconds );
+	reportThroughput( "cache write", sourceBytes, saveSeconds );
+	std::printf( "cache %s, %.1fx faster startup\n", hit ? "hit" : "MISSED",
+					 coldSeconds / hitSeconds );
+
+	std::filesystem::remove( sourcePath );
+	std::filesystem::remove( cachePath );
+	return hit ? 0 : 1;
+}
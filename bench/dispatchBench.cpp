@@ -0,0 +1,83 @@
+// bench\dispatchBench.cpp
+// The bytecode VM on programs that are almost nothing but dispatch: tight loops of one-cycle
+// instructions. Built twice, as CarpBenchDispatch (switch) and CarpBenchDispatchGoto (computed
+// goto), so the two loops can be compared on the same programs.
+// usage: CarpBenchDispatch[Goto] [iterations]
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "../src/headers/SemanticAnalyser.hpp"
+#include "../src/headers/parser.hpp"
+#include "../src/headers/tokeniser.hpp"
+#include "../src/interpreter/compiler.hpp"
+#include "../src/interpreter/vm.hpp"
+#include "benchUtils.hpp"
+
+// three instructions a trip: Add, Less, JumpIfTrue
+static std::string makeCountSource( const long iterations )
+{
+	return "int i = 0;\n"
+			 "while ( i < " +
+			 std::to_string( iterations ) + " ) {\n   i = i + 1;\n}\n";
+}
+
+// a branch that goes one way, then the other: the jumps are hard to predict
+static std::string makeBranchSource( const long iterations )
+{
+	return "int i = 0;\n"
+			 "int evens = 0;\n"
+			 "int odds = 0;\n"
+			 "while ( i < " +
+			 std::to_string( iterations ) +
+			 " ) {\n"
+			 "   i = i + 1;\n"
+			 "   if ( i / 2 * 2 == i ) { evens = evens + i; } else { odds = odds + 1; }\n"
+			 "}\n";
+}
+
+// a short inner loop inside an outer one, with a mix of ops
+static std::string makeNestedSource( const long iterations )
+{
+	return "int total = 0;\n"
+			 "int i = 0;\n"
+			 "while ( i < " +
+			 std::to_string( iterations / 100 ) +
+			 " ) {\n"
+			 "   int j = 0;\n"
+			 "   while ( j < 100 ) {\n"
+			 "      if ( j > 50 ) { total = total + j * 3; } else { total = total - j; }\n"
+			 "      j = j + 1;\n"
+			 "   }\n"
+			 "   i = i + 1;\n"
+			 "}\n";
+}
+
+static void benchProgram( const char* name, const std::string& source, const long iterations )
+{
+	Interner interner;
+	Tokeniser tokeniser( source, interner );
+	const std::vector<Token> tokens = tokeniser.tokenise();
+	CompilationUnit unit;
+	Parser( tokens, unit ).parse();
+	const LineTable lines( source );
+	SemanticAnalyser analyser( lines );
+	analyser.analyse( unit.program );
+	const Bytecode code = BytecodeCompiler().compile( unit.program, analyser.frameSize() );
+
+	const double seconds = bestOf( 5, [ & ] { VirtualMachine().run( code ); } );
+	std::printf( "%-28s %9.3f ms  %9.2f ns a loop trip (%zu instructions of code)\n", name,
+					 seconds * 1e3, seconds * 1e9 / static_cast<double>( iterations ), code.code.size() );
+}
+
+int main( int argc, char* argv[] )
+{
+	const long iterations = argc > 1 ? std::strtol( argv[ 1 ], nullptr, 10 ) : 10000000;
+	std::printf( "\nbytecode VM, %s dispatch, %ld loop trips each\n", VirtualMachine::dispatch(),
+					 iterations );
+	benchProgram( "count", makeCountSource( iterations ), iterations );
+	benchProgram( "branch", makeBranchSource( iterations ), iterations );
+	benchProgram( "nested", makeNestedSource( iterations ), iterations );
+	return 0;
+}
@@ -0,0 +1,70 @@
+// bench\lexerBench.cpp
+// Tokeniser throughput on a large comment- and whitespace-heavy program, and on dense code.
+// usage: CarpBenchLexer [megabytes]
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "../src/headers/lexScan.hpp"
+#include "../src/headers/tokeniser.hpp"
+#include "benchUtils.hpp"
+
+static void runInput( const char* name, const std::string& source )
+{
+	std::printf( "\n%s input: %zu bytes\n", name, source.size() );
+
+	size_t tokenCount = 0;
+	for ( const lexscan::Level level :
+			{ lexscan::Level::Scalar, lexscan::Level::SSE2, lexscan::Level::AVX2 } ) {
+		if ( level > lexscan::bestLevel() ) {
+			continue;  // the CPU can't run it
+		}
+		lexscan::setLevel( level );
+
+		// lexing alone (streaming, nothing stored)...
+		const double streamSeconds = bestOf( 5, [ & ] {
+			Interner interner;
+			Tokeniser tokeniser( source, interner );
+			size_t count = 0;
+			while ( tokeniser.next().type != TokenType::T_EOF ) {
+				++count;
+			}
+			doNotOptimise( count );
+		} );
+		// ...and the full token vector the parser normally gets
+		const double vectorSeconds = bestOf( 5, [ & ] {
+			Interner interner;
+			Tokeniser tokeniser( source, interner );
+			const auto tokens = tokeniser.tokenise();
+			tokenCount = tokens.size();
+			doNotOptimise( tokens );
+		} );
+
+		const std::string label = lexscan::levelName( level );
+		reportThroughput( ( label + " next()" ).c_str(), source.size(), streamSeconds );
+		reportThroughput( ( label + " tokenise()" ).c_str(), source.size(), vectorSeconds );
+	}
+	lexscan::setLevel( lexscan::bestLevel() );
+
+	// the whole file split across every core (needs a multi-core machine to show anything)
+	const double parallelSeconds = bestOf( 5, [ & ] {
+		Interner interner;
+		Tokeniser tokeniser( source, interner );
+		tokeniser.setParallel( 0, 0 );
+		const auto tokens = tokeniser.tokenise();
+		doNotOptimise( tokens );
+	} );
+	reportThroughput( "parallel tokenise()", source.size(), parallelSeconds );
+
+	std::printf( "tokens: %zu\n", tokenCount );
+}
+
+int main( int argc, char* argv[] )
+{
+	const size_t megabytes = argc > 1 ? std::strtoul( argv[ 1 ], nullptr, 10 ) : 32;
+	const size_t bytes = megabytes * 1024 * 1024;
+	runInput( "comment-heavy", makeCarpSource( bytes ) );
+	runInput( "dense code", makeDenseCarpSource( bytes ) );
+	return 0;
+}
@@ -0,0 +1,110 @@
+// bench\parserBench.cpp
+// Parser speed, AST teardown and AST size (pointer tree vs flat) on large generated programs,
+// plus expression-only inputs for the operator parsing. Tokens are lexed once up front.
+// usage: CarpBenchParser [megabytes]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "../src/headers/flatAst.hpp"
+#include "../src/headers/parser.hpp"
+#include "../src/headers/tokeniser.hpp"
+#include "benchUtils.hpp"
+
+static void runInput( const char* name, const std::string& source )
+{
+	Interner interner;
+	Tokeniser tokeniser( source, interner );
+	const std::vector<Token> tokens = tokeniser.tokenise();
+	std::printf( "\n%s input: %zu bytes, %zu tokens\n", name, source.size(), tokens.size() );
+
+	double parseBest = 1e300;
+	double teardownBest = 1e300;
+	size_t arenaBytes = 0;
+	for ( int rep = 0; rep < 5; ++rep ) {
+		auto unit = std::make_unique<CompilationUnit>();
+
+		const auto start = std::chrono::steady_clock::now();
+		Parser parser( tokens, *unit );
+		parser.parse();
+		const auto parsed = std::chrono::steady_clock::now();
+		arenaBytes = unit->arena.bytesUsed();
+		unit.reset();	// the whole tree in one go
+		const auto freed = std::chrono::steady_clock::now();
+
+		parseBest = std::min( parseBest, std::chrono::duration<double>( parsed - start ).count() );
+		teardownBest = std::min( teardownBest, std::chrono::duration<double>( freed - parsed ).count() );
+	}
+
+	// the same program as a flat AST
+	double flatBest = 1e300;
+	size_t flatBytes = 0;
+	size_t flatNodes = 0;
+	for ( int rep = 0; rep < 5; ++rep ) {
+		FlatAst ast;
+		const auto start = std::chrono::steady_clock::now();
+		FlatParser parser( tokens, ast );
+		parser.parse();
+		flatBest = std::min( flatBest, std::chrono::duration<double>(
+														 std::chrono::steady_clock::now() - start )
+														 .count() );
+		flatBytes = ast.bytesUsed();
+		flatNodes = ast.size();
+	}
+
+	reportThroughput( "parse() tree", source.size(), parseBest );
+	std::printf( "%-28s %9.3f ms\n", "tree teardown", teardownBest * 1e3 );
+	reportThroughput( "parse() flat", source.size(), flatBest );
+	std::printf( "%zu nodes: tree %zu bytes (%.1f a node), flat %zu bytes (%.1f a node)\n", flatNodes,
+					 arenaBytes, static_cast<double>( arenaBytes ) / static_cast<double>( flatNodes ),
+					 flatBytes, static_cast<double>( flatBytes ) / static_cast<double>( flatNodes ) );
+}
+
+// long chains of every binary operator: `x = a + 1 * b - 2 / c == ... ;`
+static std::string makeFlatExpressions( const size_t bytes )
+{
+	static const char* const ops[] = { " + ", " * ", " - ", " / ", " == ", " < ", " != ", " >= " };
+	std::string src = "int a = 1;\nint b = 2;\nint c = 3;\nbool x = true;\n";
+	while ( src.size() < bytes ) {
+		src += "x = a";
+		for ( int i = 0; i < 256; ++i ) {
+			src += ops[ i % 8 ];
+			src += i % 3 == 0 ? "b" : std::to_string( i );
+		}
+		src += ";\n";
+	}
+	return src;
+}
+
+// expressions nested `depth` brackets deep, with an operator and a unary minus at every level
+// (three levels of parser nesting each, so keep it under a third of Parser::DefaultMaxDepth)
+static std::string makeNestedExpressions( const size_t bytes, const int depth )
+{
+	std::string src = "int a = 1;\n";
+	while ( src.size() < bytes ) {
+		src += "a = ";
+		for ( int i = 0; i < depth; ++i ) {
+			src += "-(a + ";
+		}
+		src += "1";
+		for ( int i = 0; i < depth; ++i ) {
+			src += ")";
+		}
+		src += ";\n";
+	}
+	return src;
+}
+
+int main( int argc, char* argv[] )
+{
+	const size_t megabytes = argc > 1 ? std::strtoul( argv[ 1 ], nullptr, 10 ) : 16;
+	const size_t bytes = megabytes * 1024 * 1024;
+	runInput( "comment-heavy", makeCarpSource( bytes ) );
+	runInput( "dense code", makeDenseCarpSource( bytes ) );
+	runInput( "flat expressions", makeFlatExpressions( bytes ) );
+	runInput( "nested expressions", makeNestedExpressions( bytes, 250 ) );
+	return 0;
+}
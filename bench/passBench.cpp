@@ -0,0 +1,123 @@
+// bench\passBench.cpp
+// The passes after the parser: the semantic analyser on large generated programs, and running
+// a loop-heavy one (as written and after -O1) on the tree walker, from the pointer tree and
+// from the flat AST, and on the bytecode VM.
+// usage: CarpBenchPasses [megabytes] [loop iterations]
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "../src/headers/SemanticAnalyser.hpp"
+#include "../src/headers/constantFolder.hpp"
+#include "../src/headers/flatAst.hpp"
+#include "../src/headers/parser.hpp"
+#include "../src/headers/tokeniser.hpp"
+#include "../src/interpreter/compiler.hpp"
+#include "../src/interpreter/interpreter.hpp"
+#include "../src/interpreter/vm.hpp"
+#include "benchUtils.hpp"
+
+// a few statements run `iterations` times: every node is dispatched over and over.
+// `step` and `( 2 - 1 )` are what -O1 turns into plain numbers
+static std::string makeLoopSource( const long iterations )
+{
+	return "int i = 0;\n"
+			 "int evens = 0;\n"
+			 "int odds = 0;\n"
+			 "int step = 60 * 60 / 3600;\n"
+			 "while ( i < " +
+			 std::to_string( iterations ) +
+			 " ) {\n"
+			 "   i = i + step;\n"
+			 "   if ( i / 2 * 2 == i ) { evens = evens + i * ( 2 - 1 ); } else { odds = odds + 1; }\n"
+			 "}\n";
+}
+
+// small blocks, each declaring and shadowing a few names: scope entry, exit and lookups
+static std::string makeBlockSource( const size_t bytes )
+{
+	std::string src = "int a = 0;\n";
+	for ( int i = 0; src.size() < bytes; ++i ) {
+		const std::string n = std::to_string( i );
+		src += "int x" + n + " = " + n + ";\nif ( x" + n + " > a ) { int a = x" + n +
+				 "; while ( a < 2 ) { int b = a + 1; { int a = b; } a = b; } } else { int c = a; }\n";
+	}
+	return src;
+}
+
+static void reportPerNode( const char* label, const double seconds, const size_t nodes )
+{
+	std::printf( "%-28s %9.3f ms  %9.2f ns a node\n", label, seconds * 1e3,
+					 seconds * 1e9 / static_cast<double>( nodes ) );
+}
+
+static void benchAnalyser( const char* name, const std::string& source )
+{
+	Interner interner;
+	Tokeniser tokeniser( source, interner );
+	const std::vector<Token> tokens = tokeniser.tokenise();
+	CompilationUnit unit;
+	Parser( tokens, unit ).parse();
+	FlatAst flat;
+	FlatParser( tokens, flat ).parse();
+	const LineTable lines( source );
+
+	std::printf( "\nanalyse, %s input: %zu bytes, %zu nodes\n", name, source.size(), flat.size() );
+	reportPerNode( "analyse() tree",
+						bestOf( 5, [ & ] { SemanticAnalyser( lines ).analyse( unit.program ); } ),
+						flat.size() );
+	reportPerNode( "analyse() flat", bestOf( 5, [ & ] { SemanticAnalyser( lines ).analyse( flat ); } ),
+						flat.size() );
+}
+
+static void benchInterpreter( const long iterations )
+{
+	const std::string source = makeLoopSource( iterations );
+	Interner interner;
+	Tokeniser tokeniser( source, interner );
+	const std::vector<Token> tokens = tokeniser.tokenise();
+	CompilationUnit unit;
+	Parser( tokens, unit ).parse();
+	FlatAst flat;
+	FlatParser( tokens, flat ).parse();
+	const LineTable lines( source );
+	SemanticAnalyser analyser( lines );
+	analyser.analyse( unit.program );	// resolves the variables to slots
+	SemanticAnalyser( lines ).analyse( flat );
+	const Slot frameSize = analyser.frameSize();
+
+	// roughly how many nodes one iteration visits at -O0: the condition, the body and the taken
+	// branch (per node figures stay against this count at -O1, so fewer visits show as faster)
+	const size_t visited = static_cast<size_t>( iterations ) * 23;
+	std::printf( "\nexecute, loop of %ld iterations (~%zu node visits)\n", iterations, visited );
+	reportPerNode( "execute() tree -O0",
+						bestOf( 3, [ & ] { Interpreter().execute( unit.program, frameSize ); } ),
+						visited );
+	reportPerNode( "execute() flat -O0",
+						bestOf( 3, [ & ] { Interpreter().execute( flat, frameSize ); } ), visited );
+	const Bytecode code = BytecodeCompiler().compile( unit.program, frameSize );
+	reportPerNode( "bytecode VM -O0", bestOf( 3, [ & ] { VirtualMachine().run( code ); } ),
+						visited );
+
+	ConstantFolder().fold( unit );
+	ConstantFolder().fold( flat );
+	reportPerNode( "execute() tree -O1",
+						bestOf( 3, [ & ] { Interpreter().execute( unit.program, frameSize ); } ),
+						visited );
+	reportPerNode( "execute() flat -O1",
+						bestOf( 3, [ & ] { Interpreter().execute( flat, frameSize ); } ), visited );
+	const Bytecode folded = BytecodeCompiler().compile( unit.program, frameSize );
+	reportPerNode( "bytecode VM -O1", bestOf( 3, [ & ] { VirtualMachine().run( folded ); } ),
+						visited );
+}
+
+int main( int argc, char* argv[] )
+{
+	const size_t megabytes = argc > 1 ? std::strtoul( argv[ 1 ], nullptr, 10 ) : 16;
+	const long iterations = argc > 2 ? std::strtol( argv[ 2 ], nullptr, 10 ) : 1000000;
+	benchAnalyser( "comment-heavy", makeCarpSource( megabytes * 1024 * 1024 ) );
+	benchAnalyser( "block-heavy", makeBlockSource( megabytes * 1024 * 1024 ) );
+	benchInterpreter( iterations );
+	return 0;
+}
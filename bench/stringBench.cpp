@@ -0,0 +1,118 @@
+// bench\stringBench.cpp
+// Carp strings at run time: how long string-heavy loops take on the tree walker and the bytecode
+// VM, and how many heap allocations each loop trip costs. Every allocation in the process goes
+// through the counting operator new below; the compile happens before counting starts.
+// usage: CarpBenchStrings [iterations]
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "../src/headers/SemanticAnalyser.hpp"
+#include "../src/headers/parser.hpp"
+#include "../src/headers/tokeniser.hpp"
+#include "../src/interpreter/compiler.hpp"
+#include "../src/interpreter/interpreter.hpp"
+#include "../src/interpreter/vm.hpp"
+#include "benchUtils.hpp"
+
+static size_t g_allocations = 0;
+static size_t g_allocatedBytes = 0;
+
+void* operator new( const size_t size )
+{
+	++g_allocations;
+	g_allocatedBytes += size;
+	if ( void* p = std::malloc( size ? size : 1 ) ) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+void operator delete( void* p ) noexcept { std::free( p ); }
+void operator delete( void* p, size_t ) noexcept { std::free( p ); }
+
+// long literals read and copied, nothing built
+static std::string makeCopySource( const long iterations )
+{
+	return "string greeting = \"hello from a string longer than any inline buffer\";\n"
+			 "string last = \"\";\n"
+			 "int i = 0;\n"
+			 "while ( i < " +
+			 std::to_string( iterations ) +
+			 " ) {\n"
+			 "   string copy = greeting;\n"
+			 "   last = copy;\n"
+			 "   i = i + 1;\n"
+			 "}\n";
+}
+
+// short strings joined and compared: every result fits inside a Value
+static std::string makeShortSource( const long iterations )
+{
+	return "string tag = \"id\";\n"
+			 "int hits = 0;\n"
+			 "int i = 0;\n"
+			 "while ( i < " +
+			 std::to_string( iterations ) +
+			 " ) {\n"
+			 "   string key = tag + \"-\" + \"42\";\n"
+			 "   if ( key == \"id-42\" ) { hits = hits + 1; }\n"
+			 "   i = i + 1;\n"
+			 "}\n";
+}
+
+// a message built up one part a trip: quadratic if every + copied the whole string
+static std::string makeBuildSource( const long iterations )
+{
+	return "string msg = \"\";\n"
+			 "int i = 0;\n"
+			 "while ( i < " +
+			 std::to_string( iterations ) +
+			 " ) {\n"
+			 "   msg = msg + \"part \";\n"
+			 "   i = i + 1;\n"
+			 "}\n";
+}
+
+template <typename Fn>
+static void report( const char* name, const long iterations, Fn&& run )
+{
+	const size_t allocations = g_allocations;
+	const size_t bytes = g_allocatedBytes;
+	run();
+	const auto trips = static_cast<double>( iterations );
+	const size_t made = g_allocations - allocations;
+	const double bytesPerTrip = static_cast<double>( g_allocatedBytes - bytes ) / trips;
+
+	const double seconds = bestOf( 5, run );
+	std::printf( "%-14s %9.3f ms  %8zu allocations (%.4f a loop trip), %8.2f bytes a loop trip\n",
+					 name, seconds * 1e3, made, static_cast<double>( made ) / trips, bytesPerTrip );
+}
+
+static void benchProgram( const char* name, const std::string& source, const long iterations )
+{
+	Interner interner;
+	Tokeniser tokeniser( source, interner );
+	const std::vector<Token> tokens = tokeniser.tokenise();
+	CompilationUnit unit;
+	Parser( tokens, unit ).parse();
+	const LineTable lines( source );
+	SemanticAnalyser analyser( lines );
+	analyser.analyse( unit.program );
+	const Slot frameSize = analyser.frameSize();
+	const Bytecode code = BytecodeCompiler().compile( unit.program, frameSize );
+
+	std::printf( "\n%s, %ld loop trips\n", name, iterations );
+	report( "tree walker", iterations, [ & ] { Interpreter().execute( unit.program, frameSize ); } );
+	report( "bytecode VM", iterations, [ & ] { VirtualMachine().run( code ); } );
+}
+
+int main( int argc, char* argv[] )
+{
+	const long iterations = argc > 1 ? std::strtol( argv[ 1 ], nullptr, 10 ) : 1000000;
+	benchProgram( "copy long literals", makeCopySource( iterations ), iterations );
+	benchProgram( "join short strings", makeShortSource( iterations ), iterations );
+	benchProgram( "build a message", makeBuildSource( iterations ), iterations );
+	return 0;
+}
@@ -1,215 +1,364 @@
 // src\SemanticAnalyser.cpp
 #include "headers/SemanticAnalyser.hpp"
+#include <algorithm>
 #include <stdexcept>
 #include "headers/parser.hpp"
 #include "headers/tokeniser.hpp"
 
 /* --------------------------------------------------------------------------------------------- */
 
-SemanticAnalyser::SemanticAnalyser() = default;
+SemanticAnalyser::SemanticAnalyser( const LineTable& lines ) : m_lines( lines ) {}
 
 void SemanticAnalyser::enterScope()
 {
-	scopeStack.emplace_back();	 // add new empty scope object in scope vector
-	// we fill it when we reach "stmts", in stmt funcs like declare within visitStmt()
+	// nothing to allocate: just remember where this scope's declarations will start
+	m_scopes.push_back( ScopeMark{ m_undo.size(), m_nextSlot } );
 }
 
 void SemanticAnalyser::exitScope()
 {
-	scopeStack.pop_back();	// remove the last element [meaning exit]
+	const ScopeMark mark = m_scopes.back();
+	// put back whatever this scope's declarations shadowed, newest first
+	while ( m_undo.size() > mark.undoSize ) {
+		const Shadowed& entry = m_undo.back();
+		m_bindings[ entry.id ] = entry.previous;
+		m_undo.pop_back();
+	}
+	// its variables are gone, so the next block can reuse their slots
+	m_nextSlot = mark.firstSlot;
+	m_scopes.pop_back();	 // remove the last element [meaning exit]
 }
 
 [[noreturn]]
-void SemanticAnalyser::error( const Location& loc, const std::string& msg )
+void SemanticAnalyser::error( const Location& loc, const std::string& msg ) const
 {
-	throw std::runtime_error( "Error at " + std::to_string( loc.line ) + ":" +
-									  std::to_string( loc.column ) + " -> " + msg );
+	const LineColumn pos = m_lines.resolve( loc );	// lines are only counted once we get here
+	throw std::runtime_error( "Error at " + std::to_string( pos.line ) + ":" +
+									  std::to_string( pos.column ) + " -> " + msg );
 }
 /* --------------------------------------------------------------------------------------------- */
 
 // returns a pointer to the Symbol of an identifier, if that id exists in any active scope.
-Symbol* SemanticAnalyser::lookup( const std::string& name )
+Symbol* SemanticAnalyser::lookup( const SymbolId id )
 {
-	// Search for this variable starting from the closest scope, outward
-	for ( auto rIter = scopeStack.rbegin(); rIter != scopeStack.rend(); ++rIter ) {
-		// we're using reverse iteration to start from innermost scope to outermost scope
-		// from child to parent, eventually to global scope
-		auto found = rIter->symbols.find( name );
-		// ↑ try to find id via name among symbols of that scope and return an iterator
-		if ( found != rIter->symbols.end() ) {
-			return &found->second;	// pointer to the Symbol stored in the map
-		}
+	// the table always holds the innermost visible declaration, no walking the scopes
+	if ( id < m_bindings.size() && m_bindings[ id ].depth != 0 ) {
+		return &m_bindings[ id ];
 	}
 	return nullptr;
-
-	// rbegin() = Give me an iterator that starts at the LAST element
-	// rend() = starts before first
 }
 
 /* --------------------------------------------------------------------------------------------- */
 
 // to keep track of declarations
-void SemanticAnalyser::declare( const std::string& name, const TokenType type )
+Slot SemanticAnalyser::declare( const SymbolId id, const std::string_view name,
+										  const TokenType type )
 {
-	auto& curent = scopeStack.back().symbols;	 // get the latest scope
+	if ( id >= m_bindings.size() ) {
+		m_bindings.resize( id + 1 );	// ids are dense, so this stays about as big as the interner
+	}
+	Symbol& binding = m_bindings[ id ];
+	const auto depth = static_cast<uint32_t>( m_scopes.size() );
 
-	if ( curent.contains( name ) ) {
-		throw std::runtime_error( "Variable redeclared: " + name );
+	// declared in this very scope already? (one from an outer scope is fine, this shadows it)
+	if ( binding.depth == depth ) {
+		throw std::runtime_error( "Variable redeclared: " + std::string( name ) );
 	}
-	curent[ name ] = Symbol{ type };	 // if not redeclared, mk key and assign it the type
+	m_undo.push_back( Shadowed{ id, binding } );	// so exitScope() can bring it back
 
-	/*
-		curent[name]
-			If key exists → returns reference to value
-			If key doesn’t exist → creates it
-		Symbol{ type }
-			Aggregate initialisation
-			Equivalent to:
-				Symbol sym;
-				sym.tType = type;
-	*/
+	const Slot slot = m_nextSlot++;
+	m_frameSize = std::max( m_frameSize, m_nextSlot );
+	binding = Symbol{ type, slot, depth };
+	return slot;
 }
 
 /* --------------------------------------------------------------------------------------------- */
 
-// answers: What type does this expression evaluate to?
-TokenType SemanticAnalyser::visitExpr( const Expr* expr )
+// answers: What type does this expression evaluate to? and writes the answer onto the node
+TokenType SemanticAnalyser::visitExpr( Expr* expr )
 {
+	expr->m_type = inferType( expr );
+	return expr->m_type;
+}
+
+TokenType SemanticAnalyser::inferType( Expr* expr )
+{
+	// every node knows its kind, so this is one jump instead of a chain of dynamic_casts
+	switch ( expr->kind ) {
 	// # Number
-	if ( auto num = dynamic_cast<const NumberExpr*>( expr ) ) {
+	case NodeKind::Number:
 		return TokenType::T_int;
-	}
 	// # String
-	if ( auto str = dynamic_cast<const StringExpr*>( expr ) ) {
+	case NodeKind::String:
 		return TokenType::T_string;
-	}
+	// # bool
+	case NodeKind::Bool:
+		return TokenType::T_bool;
 	// # Identifier
-	if ( const auto id = dynamic_cast<const IdentExpr*>( expr ) ) {  // if it has id
-		const Symbol* sym = lookup( id->name );							  // check the entire scope-stack
+	case NodeKind::Ident: {
+		auto& id = as<IdentExpr>( expr );
+		const Symbol* sym = lookup( id.symbol );	// check the entire scope-stack
 		// ↑ get id [Pointer lets you express absence (nullptr)]
 		if ( !sym ) {
-			error( id->m_loc, "Use of undeclared variable: " + id->name );
+			error( id.m_loc, "Use of undeclared variable: " + std::string( id.name ) );
 		}
+		id.slot = sym->slot;	 // the interpreter reads this slot, no lookup at run time
 		return sym->tType;
 		// basically, if identifier(symbol) exists return its type
 	}
-	// # bool
-	if ( auto b = dynamic_cast<const BoolExpr*>( expr ) ) {
-		return TokenType::T_bool;
-	}
-
 	// # Binary
-	if ( const auto bin = dynamic_cast<const BinaryExpr*>( expr ) ) {
-		const TokenType leftType = visitExpr( bin->left.get() );
-		const TokenType rightType = visitExpr( bin->right.get() );
+	case NodeKind::Binary: {
+		const auto& bin = as<BinaryExpr>( expr );
+		const TokenType leftType = visitExpr( bin.left );
+		const TokenType rightType = visitExpr( bin.right );
 		// ↑ recursively ask what type, the stuff on both side is | (x+3)
 
-		switch ( bin->operatr ) {
-			// Arithmatic
-		case TokenType::T_plus:
-		case TokenType::T_minus:
-		case TokenType::T_star:
-		case TokenType::T_slash:
-			if ( leftType != TokenType::T_int || rightType != TokenType::T_int ) {
-				error( bin->m_loc, "Arithmetic operators require int operands" );
-			}
-			return TokenType::T_int;
-		// Comparison
-		case TokenType::T_GrT:
-		case TokenType::T_LeT:
-		case TokenType::T_GrTEq:
-		case TokenType::T_LeTEq:
-			if ( leftType != TokenType::T_int || rightType != TokenType::T_int ) {
-				error( bin->m_loc, "Comparison requires int operands" );
-			}
-			return TokenType::T_bool;
-		// Equality
-		case TokenType::T_eqEq:
-		case TokenType::T_NotE:
-			if ( leftType != rightType ) {
-				error( bin->m_loc, "Equality operands must be same Type" );
-			}
-			return TokenType::T_bool;
-		default:
-			error( bin->m_loc, "Unknown Binary Operator" );
-		}
-	}
-
-	error( expr->m_loc, "Unknown expression type" );
+		return binaryType( bin.operatr, leftType, rightType, bin.m_loc );
+	}
+	default:
+		error( expr->m_loc, "Unknown expression type" );
+	}
+}
+
+// what `left op right` evaluates to, or an error if the operand types don't fit the operator
+TokenType SemanticAnalyser::binaryType( const TokenType op, const TokenType leftType,
+													 const TokenType rightType, const Location& loc ) const
+{
+	switch ( op ) {
+		// Arithmatic
+	case TokenType::T_plus:
+		// + also joins two strings
+		if ( leftType == TokenType::T_string && rightType == TokenType::T_string ) {
+			return TokenType::T_string;
+		}
+		[[fallthrough]];
+	case TokenType::T_minus:
+	case TokenType::T_star:
+	case TokenType::T_slash:
+		if ( leftType != TokenType::T_int || rightType != TokenType::T_int ) {
+			error( loc, "Arithmetic operators require int operands" );
+		}
+		return TokenType::T_int;
+	// Comparison
+	case TokenType::T_GrT:
+	case TokenType::T_LeT:
+	case TokenType::T_GrTEq:
+	case TokenType::T_LeTEq:
+		if ( leftType != TokenType::T_int || rightType != TokenType::T_int ) {
+			error( loc, "Comparison requires int operands" );
+		}
+		return TokenType::T_bool;
+	// Equality
+	case TokenType::T_eqEq:
+	case TokenType::T_NotE:
+		if ( leftType != rightType ) {
+			error( loc, "Equality operands must be same Type" );
+		}
+		return TokenType::T_bool;
+	default:
+		error( loc, "Unknown Binary Operator" );
+	}
 }
+
 /* --------------------------------------------------------------------------------------------- */
 // This is a dispatcher that walks the AST and enforces semantic rules.
 //  Semantics = meaning.
 
-void SemanticAnalyser::visitStmt( const Stmt* stmt )
+void SemanticAnalyser::visitStmt( Stmt* stmt )
 {
+	switch ( stmt->kind ) {
 	// # declaration
-	//  here it tries to cast, if it passes then we know it is varDecl. if not then ship to next 'if'
-	if ( const auto v = dynamic_cast<const VarDeclStmt*>( stmt ) ) {
-		const TokenType exprType = visitExpr( v->expr.get() );  // visitExpr returns a TokenType
+	case NodeKind::VarDecl: {
+		auto& v = as<VarDeclStmt>( stmt );
+		const TokenType exprType = visitExpr( v.expr );	// visitExpr returns a TokenType
 		// get the expr type (like intLit/strLit etc) and compare
-		if ( exprType != v->type ) {	// here v->type is the type decl like int,string,float
-			error( v->m_loc, "Type mismatch in declaration of " + v->name );
+		if ( exprType != v.type ) {  // here v.type is the type decl like int,string,float
+			error( v.m_loc, "Type mismatch in declaration of " + std::string( v.name ) );
 		}
-		declare( v->name, v->type );	// this stores it in current scope within scope-stack
+		// this stores it in current scope within scope-stack, and gives it a slot
+		v.slot = declare( v.symbol, v.name, v.type );
 		return;
 	}
 	// # assignment
-	if ( const auto a = dynamic_cast<const AssignStmt*>( stmt ) ) {
-		const Symbol* sym = lookup( a->name );	 // check if id exists or not
+	case NodeKind::Assign: {
+		auto& a = as<AssignStmt>( stmt );
+		const Symbol* sym = lookup( a.symbol );  // check if id exists or not
 		if ( !sym ) {
-			error( a->m_loc, "Assignment to undeclared variable: " + a->name );
+			error( a.m_loc, "Assignment to undeclared variable: " + std::string( a.name ) );
 		}
-		const TokenType valueType = visitExpr( a->value.get() );	 // get the expr
+		const TokenType valueType = visitExpr( a.value );  // get the expr
 		if ( valueType != sym->tType ) {
-			error( a->m_loc, "Type mismatch in assignment to " + a->name );
+			error( a.m_loc, "Type mismatch in assignment to " + std::string( a.name ) );
 		}
+		a.slot = sym->slot;
 		return;
 	}
 	// # blocks
-	if ( const auto b = dynamic_cast<const BlockStmt*>( stmt ) ) {
+	case NodeKind::Block:
 		enterScope();
-		for ( auto& st : b->statements ) {
-			visitStmt( st.get() );	// recursively check the inner stmts
+		for ( Stmt* st : as<BlockStmt>( stmt ).statements ) {
+			visitStmt( st );	// recursively check the inner stmts
 
-			// What .get() does
-			// Returns the raw pointer inside unique_ptr.
-			// Ownership does not change.
+			// the nodes are plain pointers into the CompilationUnit's arena,
+			// no ownership involved: the unit frees them all at once
 		}
 		exitScope();
 		return;
-	}
 	// if
-	if ( const auto i = dynamic_cast<const IfStmt*>( stmt ) ) {
-		const auto condType = visitExpr( i->condition.get() );
+	case NodeKind::If: {
+		const auto& i = as<IfStmt>( stmt );
+		const auto condType = visitExpr( i.condition );
 		if ( condType != TokenType::T_bool ) {
-			error( i->m_loc, "condition expression must evaluate to a boolean" );
+			error( i.m_loc, "condition expression must evaluate to a boolean" );
 		}
-		visitStmt( i->thenBranch.get() );
-		if ( i->elseBranch ) {
-			visitStmt( i->elseBranch.get() );
+		visitBody( i.thenBranch );
+		if ( i.elseBranch ) {
+			visitBody( i.elseBranch );
 		}
 		return;
 	}
 	// while
-	if ( const auto w = dynamic_cast<const WhileStmt*>( stmt ) ) {
-		const auto condType = visitExpr( w->condition.get() );
+	case NodeKind::While: {
+		const auto& w = as<WhileStmt>( stmt );
+		const auto condType = visitExpr( w.condition );
 		if ( condType != TokenType::T_bool ) {
-			error( w->m_loc, "condition expression must evaluate to a boolean" );
+			error( w.m_loc, "condition expression must evaluate to a boolean" );
 		}
-		visitStmt( w->loopBody.get() );
+		visitBody( w.loopBody );
+		return;
+	}
+	default:
+		throw std::runtime_error( "Unknown Statement type" );
+	}
+}
+
+// the body of an if or while is a scope of its own, also without braces: in
+// `if ( c ) int x = 1;` x only exists when c is true, so nothing after the if may see it
+// (or read its slot, which the next block is free to reuse for something else)
+void SemanticAnalyser::visitBody( Stmt* body )
+{
+	if ( body->kind == NodeKind::Block ) {
+		visitStmt( body );  // opens its own scope
 		return;
 	}
-	throw std::runtime_error( "Unknown Statement type" );
+	enterScope();
+	visitStmt( body );
+	exitScope();
 }
 
 /* --------------------------------------------------------------------------------------------- */
 
-void SemanticAnalyser::analyse( const std::vector<std::unique_ptr<Stmt>>& program )
+void SemanticAnalyser::analyse( const std::vector<Stmt*>& program )
+{
+	enterScope();	// global scope
+	for ( Stmt* stmt : program ) {
+		visitStmt( stmt );
+	}
+	exitScope();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+// # The flat AST: the same checks as above, the kind comes from an array instead of the node
+
+TokenType SemanticAnalyser::visitExpr( FlatAst& ast, const NodeIndex node )
+{
+	ast.types[ node ] = inferType( ast, node );
+	return ast.types[ node ];
+}
+
+TokenType SemanticAnalyser::inferType( FlatAst& ast, const NodeIndex node )
+{
+	switch ( ast.kinds[ node ] ) {
+	case NodeKind::Number:
+		return TokenType::T_int;
+	case NodeKind::String:
+		return TokenType::T_string;
+	case NodeKind::Bool:
+		return TokenType::T_bool;
+	case NodeKind::Ident: {
+		const Symbol* sym = lookup( ast.a[ node ] );
+		if ( !sym ) {
+			error( ast.locs[ node ], "Use of undeclared variable: " + std::string( ast.name( node ) ) );
+		}
+		ast.c[ node ] = sym->slot;
+		return sym->tType;
+	}
+	case NodeKind::Binary: {
+		const TokenType leftType = visitExpr( ast, ast.a[ node ] );
+		const TokenType rightType = visitExpr( ast, ast.b[ node ] );
+		return binaryType( ast.tags[ node ], leftType, rightType, ast.locs[ node ] );
+	}
+	default:
+		error( ast.locs[ node ], "Unknown expression type" );
+	}
+}
+
+void SemanticAnalyser::visitStmt( FlatAst& ast, const NodeIndex node )
+{
+	const Location loc = ast.locs[ node ];
+	switch ( ast.kinds[ node ] ) {
+	case NodeKind::VarDecl: {
+		const TokenType declared = ast.tags[ node ];
+		if ( visitExpr( ast, ast.b[ node ] ) != declared ) {
+			error( loc, "Type mismatch in declaration of " + std::string( ast.name( node ) ) );
+		}
+		ast.c[ node ] = declare( ast.a[ node ], ast.name( node ), declared );
+		return;
+	}
+	case NodeKind::Assign: {
+		const Symbol* sym = lookup( ast.a[ node ] );
+		if ( !sym ) {
+			error( loc, "Assignment to undeclared variable: " + std::string( ast.name( node ) ) );
+		}
+		if ( visitExpr( ast, ast.b[ node ] ) != sym->tType ) {
+			error( loc, "Type mismatch in assignment to " + std::string( ast.name( node ) ) );
+		}
+		ast.c[ node ] = sym->slot;
+		return;
+	}
+	case NodeKind::Block:
+		enterScope();
+		for ( const NodeIndex st : ast.blockStatements( node ) ) {
+			visitStmt( ast, st );
+		}
+		exitScope();
+		return;
+	case NodeKind::If:
+		if ( visitExpr( ast, ast.a[ node ] ) != TokenType::T_bool ) {
+			error( loc, "condition expression must evaluate to a boolean" );
+		}
+		visitBody( ast, ast.b[ node ] );
+		if ( ast.c[ node ] != NoNode ) {
+			visitBody( ast, ast.c[ node ] );
+		}
+		return;
+	case NodeKind::While:
+		if ( visitExpr( ast, ast.a[ node ] ) != TokenType::T_bool ) {
+			error( loc, "condition expression must evaluate to a boolean" );
+		}
+		visitBody( ast, ast.b[ node ] );
+		return;
+	default:
+		throw std::runtime_error( "Unknown Statement type" );
+	}
+}
+
+void SemanticAnalyser::visitBody( FlatAst& ast, const NodeIndex body )
+{
+	if ( ast.kinds[ body ] == NodeKind::Block ) {
+		visitStmt( ast, body );
+		return;
+	}
+	enterScope();
+	visitStmt( ast, body );
+	exitScope();
+}
+
+void SemanticAnalyser::analyse( FlatAst& ast )
 {
 	enterScope();	// global scope
-	for ( auto& stmt : program ) {
-		visitStmt( stmt.get() );
+	for ( const NodeIndex stmt : ast.program ) {
+		visitStmt( ast, stmt );
 	}
 	exitScope();
 }
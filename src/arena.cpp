@@ -0,0 +1,30 @@
+// src\arena.cpp
+#include "headers/arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+void* Arena::allocate( const size_t bytes, const size_t align )
+{
+	// round the cursor up to the alignment (align is always a power of two)
+	auto address = reinterpret_cast<uintptr_t>( m_next );
+	uintptr_t aligned = ( address + align - 1 ) & ~( align - 1 );
+	if ( !m_next || aligned + bytes > reinterpret_cast<uintptr_t>( m_end ) ) {
+		grow( bytes + align );
+		address = reinterpret_cast<uintptr_t>( m_next );
+		aligned = ( address + align - 1 ) & ~( align - 1 );
+	}
+	m_next = reinterpret_cast<std::byte*>( aligned + bytes );
+	m_used += bytes;
+	return reinterpret_cast<void*>( aligned );
+}
+
+void Arena::grow( const size_t minBytes )
+{
+	// whatever is left of the current block is abandoned, the next one is at least as big
+	const size_t size = std::max( m_nextBlockBytes, minBytes );
+	m_blocks.push_back( std::make_unique_for_overwrite<std::byte[]>( size ) );
+	m_next = m_blocks.back().get();
+	m_end = m_next + size;
+	m_nextBlockBytes = std::min( m_nextBlockBytes * 2, MaxBlockBytes );
+}
@@ -0,0 +1,315 @@
+// src\astCache.cpp
+#include "headers/astCache.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include "headers/sourceFile.hpp"
+
+// the build sets this from the project version; a cache is only trusted by the version that made it
+#ifndef CARP_VERSION
+#define CARP_VERSION "unknown"
+#endif
+
+namespace astcache
+{
+
+namespace
+{
+
+// names and string literals on disk: where the text is in the source
+struct TextRef {
+	uint32_t offset;
+	uint32_t length;
+};
+
+// the FlatAst arrays in file order, see forEachArray()
+enum Array : uint32_t
+{
+	Kinds,
+	Tags,
+	A,
+	B,
+	C,
+	Locs,
+	Types,
+	Numbers,
+	Lists,
+	Program,
+	Literals,
+	Names,
+	Count
+};
+
+struct Header {
+	char magic[ 8 ];			// "CARPAST" and a '\0'
+	uint32_t byteOrder;		// ByteOrderMark as written: a file from the other endianness is refused
+	uint32_t formatVersion;
+	uint64_t compilerId;		// contentHash( CARP_VERSION )
+	uint64_t sourceSize;
+	uint64_t sourceHash;
+	uint64_t payloadHash;	// of everything after the header: catches truncated or damaged files
+	uint32_t counts[ Array::Count ];
+	uint32_t unused;			// keeps the header a multiple of 8 bytes
+};
+static_assert( sizeof( Header ) % 8 == 0 );
+
+constexpr char Magic[ 8 ] = "CARPAST";
+constexpr uint32_t ByteOrderMark = 0x01020304;
+
+uint64_t compilerId()
+{
+	return contentHash( CARP_VERSION );
+}
+
+constexpr size_t alignUp( const size_t n )
+{
+	return ( n + 7 ) & ~size_t( 7 );
+}
+
+// calls fn( array ) for every plain (copied as is) FlatAst array, in file order.
+// save and load both go through here, so they can't disagree about the layout
+template <typename Ast, typename Fn>
+void forEachArray( Ast& ast, Fn&& fn )
+{
+	fn( ast.kinds );
+	fn( ast.tags );
+	fn( ast.a );
+	fn( ast.b );
+	fn( ast.c );
+	fn( ast.locs );
+	fn( ast.types );
+	fn( ast.numbers );
+	fn( ast.lists );
+	fn( ast.program );
+}
+
+/* ---- writing ---- */
+
+void append( std::vector<char>& out, const void* data, const size_t bytes )
+{
+	const auto* first = static_cast<const char*>( data );
+	out.insert( out.end(), first, first + bytes );
+	out.resize( alignUp( out.size() ) );  // the next array starts 8 byte aligned
+}
+
+// every view must point into `source`, that's what makes the offsets meaningful
+std::vector<TextRef> textRefs( const std::vector<std::string_view>& views,
+									  const std::string_view source )
+{
+	std::vector<TextRef> refs;
+	refs.reserve( views.size() );
+	for ( const std::string_view view : views ) {
+		if ( view.empty() ) {
+			refs.push_back( { 0, 0 } );  // an id that never got a name
+			continue;
+		}
+		if ( view.data() < source.data() ||
+			  view.data() + view.size() > source.data() + source.size() ) {
+			throw std::runtime_error( "AST text is not part of the source, can't cache it" );
+		}
+		refs.push_back( { static_cast<uint32_t>( view.data() - source.data() ),
+								static_cast<uint32_t>( view.size() ) } );
+	}
+	return refs;
+}
+
+/* ---- reading ---- */
+
+// the payload of a cache file, read front to back. every read is bounds checked
+class Reader {
+ public:
+	explicit Reader( const std::string_view bytes ) : m_bytes( bytes ) {}
+
+	template <typename T>
+	bool read( std::vector<T>& out, const uint32_t count )
+	{
+		const size_t bytes = size_t( count ) * sizeof( T );
+		if ( bytes > m_bytes.size() - m_pos ) {
+			return false;
+		}
+		out.resize( count );
+		if ( bytes != 0 ) {
+			std::memcpy( out.data(), m_bytes.data() + m_pos, bytes );	// one copy per array
+		}
+		m_pos = std::min( alignUp( m_pos + bytes ), m_bytes.size() );
+		return true;
+	}
+
+ private:
+	std::string_view m_bytes;
+	size_t m_pos = 0;
+};
+
+bool readTexts( Reader& reader, const uint32_t count, const std::string_view source,
+					 std::vector<std::string_view>& out )
+{
+	std::vector<TextRef> refs;
+	if ( !reader.read( refs, count ) ) {
+		return false;
+	}
+	out.resize( count );
+	for ( uint32_t i = 0; i < count; ++i ) {
+		const TextRef ref = refs[ i ];
+		if ( size_t( ref.offset ) + ref.length > source.size() ) {
+			return false;
+		}
+		out[ i ] = source.substr( ref.offset, ref.length );
+	}
+	return true;
+}
+
+}	// namespace
+
+/* --------------------------------------------------------------------------------------------- */
+
+uint64_t contentHash( const std::string_view text )
+{
+	// 8 bytes a step: multiply, rotate, multiply (the core of most fast non-crypto hashes)
+	constexpr uint64_t k1 = 0x9E3779B97F4A7C15ull;
+	constexpr uint64_t k2 = 0xC2B2AE3D27D4EB4Full;
+	const char* p = text.data();
+	const size_t size = text.size();
+
+	uint64_t h = size * k1;
+	size_t i = 0;
+	for ( ; i + 8 <= size; i += 8 ) {
+		uint64_t word;
+		std::memcpy( &word, p + i, 8 );
+		h = std::rotl( h ^ ( word * k2 ), 31 ) * k1;
+	}
+	uint64_t tail = 0;
+	std::memcpy( &tail, p + i, size - i );
+	h = std::rotl( h ^ ( tail * k2 ), 31 ) * k1;
+
+	// final mix (murmur3's fmix64) so every input bit reaches every output bit
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+std::string pathFor( const std::string& sourcePath, const std::string& cacheDir,
+							const std::string_view source )
+{
+	if ( cacheDir.empty() ) {
+		return sourcePath + "c";
+	}
+	char name[ 17 ];
+	std::snprintf( name, sizeof( name ), "%016llx",
+						static_cast<unsigned long long>( contentHash( source ) ) );
+	return ( std::filesystem::path( cacheDir ) / ( std::string( name ) + ".carpc" ) ).string();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+void save( const std::string& path, const std::string_view source, const FlatAst& ast )
+{
+	const std::vector<TextRef> literals = textRefs( ast.literals, source );
+	const std::vector<TextRef> names = textRefs( ast.names, source );
+
+	Header header{};
+	std::memcpy( header.magic, Magic, sizeof( Magic ) );
+	header.byteOrder = ByteOrderMark;
+	header.formatVersion = FormatVersion;
+	header.compilerId = compilerId();
+	header.sourceSize = source.size();
+	header.sourceHash = contentHash( source );
+
+	std::vector<char> payload;
+	payload.reserve( ast.bytesUsed() + 64 * Array::Count );
+	uint32_t array = 0;
+	forEachArray( ast, [ & ]( const auto& values ) {
+		header.counts[ array++ ] = static_cast<uint32_t>( values.size() );
+		append( payload, values.data(), values.size() * sizeof( values[ 0 ] ) );
+	} );
+	header.counts[ Array::Literals ] = static_cast<uint32_t>( literals.size() );
+	append( payload, literals.data(), literals.size() * sizeof( TextRef ) );
+	header.counts[ Array::Names ] = static_cast<uint32_t>( names.size() );
+	append( payload, names.data(), names.size() * sizeof( TextRef ) );
+	header.payloadHash = contentHash( { payload.data(), payload.size() } );
+
+	// a unique temporary name, then one rename: readers see the old cache or the new one
+	const std::string temp =
+		 path + "." + std::to_string( std::chrono::steady_clock::now().time_since_epoch().count() ) +
+		 ".tmp";
+	{
+		std::ofstream out( temp, std::ios::binary | std::ios::trunc );
+		out.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+		out.write( payload.data(), static_cast<std::streamsize>( payload.size() ) );
+		out.close();  // flushes, so a full disk shows up here
+		if ( !out ) {
+			std::error_code ignored;
+			std::filesystem::remove( temp, ignored );
+			throw std::runtime_error( "Failed to write AST cache: " + path );
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename( temp, path, ec );
+	if ( ec ) {
+		std::filesystem::remove( temp, ec );
+		throw std::runtime_error( "Failed to write AST cache: " + path );
+	}
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+bool load( const std::string& path, const std::string_view source, FlatAst& out )
+{
+	out = FlatAst{};
+	SourceFile file;
+	try {
+		file = SourceFile::load( path );	 // memory-mapped, we only ever read it
+	} catch ( const std::exception& ) {
+		return false;	// no cache yet
+	}
+	const std::string_view bytes = file.text();
+
+	Header header;
+	if ( bytes.size() < sizeof( header ) ) {
+		return false;
+	}
+	std::memcpy( &header, bytes.data(), sizeof( header ) );
+	const std::string_view payload = bytes.substr( sizeof( header ) );
+
+	// cheapest checks first: a stale cache is the common miss
+	if ( std::memcmp( header.magic, Magic, sizeof( Magic ) ) != 0 ||
+		  header.byteOrder != ByteOrderMark || header.formatVersion != FormatVersion ||
+		  header.compilerId != compilerId() || header.sourceSize != source.size() ||
+		  header.sourceHash != contentHash( source ) ||
+		  header.payloadHash != contentHash( payload ) ) {
+		return false;
+	}
+	// every per-node array has one entry per node
+	for ( const uint32_t array :
+		 { Array::Tags, Array::A, Array::B, Array::C, Array::Locs, Array::Types } ) {
+		if ( header.counts[ array ] != header.counts[ Array::Kinds ] ) {
+			return false;
+		}
+	}
+
+	Reader reader( payload );
+	bool ok = true;
+	uint32_t array = 0;
+	forEachArray( out, [ & ]( auto& values ) {
+		ok = ok && reader.read( values, header.counts[ array++ ] );
+	} );
+	ok = ok && readTexts( reader, header.counts[ Array::Literals ], source, out.literals ) &&
+		  readTexts( reader, header.counts[ Array::Names ], source, out.names );
+	if ( !ok ) {
+		out = FlatAst{};
+		return false;
+	}
+	return true;
+}
+
+}	// namespace astcache
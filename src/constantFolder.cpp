@@ -0,0 +1,357 @@
+// src\constantFolder.cpp
+#include "headers/constantFolder.hpp"
+#include <algorithm>
+#include "headers/parser.hpp"
+#include "headers/tokeniser.hpp"
+#include "interpreter/interpreter.hpp"
+
+namespace
+{
+
+// the operands a fold needs: a number, or a bool (as 0/1 like at run time). nothing otherwise
+std::optional<int64_t> constantOf( const Expr* expr )
+{
+	switch ( expr->kind ) {
+	case NodeKind::Number:
+		return as<NumberExpr>( expr ).value;
+	case NodeKind::Bool:
+		return as<BoolExpr>( expr ).value ? 1 : 0;
+	default:
+		return std::nullopt;
+	}
+}
+
+std::optional<int64_t> constantOf( const FlatAst& ast, const NodeIndex node )
+{
+	switch ( ast.kinds[ node ] ) {
+	case NodeKind::Number:
+		return ast.numbers[ ast.a[ node ] ];
+	case NodeKind::Bool:
+		return ast.a[ node ];
+	default:
+		return std::nullopt;
+	}
+}
+
+// false if working `l op r` out now would hide an error the program has to raise when it runs
+bool canFold( const TokenType op, const int64_t r )
+{
+	return !( op == TokenType::T_slash && r == 0 );
+}
+
+}	// namespace
+
+/* --------------------------------------------------------------------------------------------- */
+// # What is known about each slot
+
+void ConstantFolder::remember( const Slot slot, const std::optional<int64_t> value )
+{
+	if ( slot >= m_known.size() ) {
+		m_known.resize( slot + 1 );
+	}
+	m_undo.push_back( Overwritten{ slot, m_known[ slot ] } );
+	m_known[ slot ] = value;
+}
+
+std::optional<int64_t> ConstantFolder::known( const Slot slot ) const
+{
+	return slot < m_known.size() ? m_known[ slot ] : std::nullopt;
+}
+
+void ConstantFolder::rollback( const size_t mark )
+{
+	// newest first, so a slot written twice ends up with what it held before the first write
+	while ( m_undo.size() > mark ) {
+		m_known[ m_undo.back().slot ] = m_undo.back().previous;
+		m_undo.pop_back();
+	}
+}
+
+ConstantFolder::Changes ConstantFolder::changedSince( const size_t mark ) const
+{
+	Changes changes;
+	for ( size_t i = mark; i < m_undo.size(); ++i ) {
+		changes.emplace_back( m_undo[ i ].slot, m_known[ m_undo[ i ].slot ] );
+	}
+	std::ranges::sort( changes, {}, &Changes::value_type::first );
+	const auto [ first, last ] = std::ranges::unique( changes, {}, &Changes::value_type::first );
+	changes.erase( first, last );
+	return changes;
+}
+
+void ConstantFolder::meet( const Changes& afterThen, const Changes& afterElse )
+{
+	// walk both lists in slot order. a slot only one branch wrote still holds, in the other,
+	// what it held before the if: that is what m_known has now
+	auto thenIt = afterThen.begin();
+	auto elseIt = afterElse.begin();
+	while ( thenIt != afterThen.end() || elseIt != afterElse.end() ) {
+		Slot slot = 0;
+		if ( elseIt == afterElse.end() ||
+			  ( thenIt != afterThen.end() && thenIt->first < elseIt->first ) ) {
+			slot = thenIt->first;
+		} else {
+			slot = elseIt->first;
+		}
+		std::optional<int64_t> thenValue = m_known[ slot ];
+		std::optional<int64_t> elseValue = m_known[ slot ];
+		if ( thenIt != afterThen.end() && thenIt->first == slot ) {
+			thenValue = ( thenIt++ )->second;
+		}
+		if ( elseIt != afterElse.end() && elseIt->first == slot ) {
+			elseValue = ( elseIt++ )->second;
+		}
+		remember( slot, thenValue == elseValue ? thenValue : std::nullopt );
+	}
+}
+
+/* --------------------------------------------------------------------------------------------- */
+// # The pointer tree
+
+void ConstantFolder::fold( CompilationUnit& unit )
+{
+	m_arena = &unit.arena;
+	m_known.clear();
+	m_undo.clear();
+	for ( Stmt* stmt : unit.program ) {
+		foldStmt( stmt );
+	}
+}
+
+Expr* ConstantFolder::foldExpr( Expr* expr )
+{
+	std::optional<int64_t> value;
+	switch ( expr->kind ) {
+	case NodeKind::Ident:
+		value = known( as<IdentExpr>( expr ).slot );
+		if ( !value ) {
+			return expr;
+		}
+		++m_propagated;
+		break;
+	case NodeKind::Binary: {
+		auto& bin = as<BinaryExpr>( expr );
+		bin.left = foldExpr( bin.left );	// inside out: `(5 + 3) * 2` folds the + first
+		bin.right = foldExpr( bin.right );
+		const auto l = constantOf( bin.left );
+		const auto r = constantOf( bin.right );
+		if ( !l || !r || !canFold( bin.operatr, *r ) ) {
+			return expr;
+		}
+		value = Interpreter::binaryOp( bin.operatr, *l, *r );
+		++m_folded;
+		break;
+	}
+	default:
+		return expr;  // literals are as constant as it gets
+	}
+
+	// the constant keeps the static type of what it replaces
+	Expr* constant = expr->m_type == TokenType::T_bool
+							  ? static_cast<Expr*>( m_arena->make<BoolExpr>( *value != 0, expr->m_loc ) )
+							  : m_arena->make<NumberExpr>( *value, expr->m_loc );
+	constant->m_type = expr->m_type;
+	return constant;
+}
+
+void ConstantFolder::foldStmt( Stmt* stmt )
+{
+	switch ( stmt->kind ) {
+	case NodeKind::VarDecl: {
+		auto& var = as<VarDeclStmt>( stmt );
+		var.expr = foldExpr( var.expr );
+		remember( var.slot, constantOf( var.expr ) );
+		return;
+	}
+	case NodeKind::Assign: {
+		auto& assign = as<AssignStmt>( stmt );
+		assign.value = foldExpr( assign.value );
+		remember( assign.slot, constantOf( assign.value ) );
+		return;
+	}
+	case NodeKind::Block:
+		for ( Stmt* st : as<BlockStmt>( stmt ).statements ) {
+			foldStmt( st );
+		}
+		return;
+	case NodeKind::If: {
+		auto& ifs = as<IfStmt>( stmt );
+		ifs.condition = foldExpr( ifs.condition );
+		// each branch starts from what was known before the if
+		const size_t mark = m_undo.size();
+		foldStmt( ifs.thenBranch );
+		const Changes afterThen = changedSince( mark );
+		rollback( mark );
+		if ( ifs.elseBranch ) {
+			foldStmt( ifs.elseBranch );
+		}
+		const Changes afterElse = changedSince( mark );
+		rollback( mark );
+		meet( afterThen, afterElse );
+		return;
+	}
+	case NodeKind::While: {
+		auto& w = as<WhileStmt>( stmt );
+		// the condition and the body also run after earlier trips round the loop, so whatever
+		// the body assigns isn't known in there (nor after the loop)
+		forgetAssigned( w.loopBody );
+		w.condition = foldExpr( w.condition );
+		const size_t atTop = m_undo.size();
+		foldStmt( w.loopBody );
+		rollback( atTop );
+		return;
+	}
+	default:
+		return;
+	}
+}
+
+void ConstantFolder::forgetAssigned( const Stmt* stmt )
+{
+	switch ( stmt->kind ) {
+	case NodeKind::VarDecl:
+		remember( as<VarDeclStmt>( stmt ).slot, std::nullopt );
+		return;
+	case NodeKind::Assign:
+		remember( as<AssignStmt>( stmt ).slot, std::nullopt );
+		return;
+	case NodeKind::Block:
+		for ( const Stmt* st : as<BlockStmt>( stmt ).statements ) {
+			forgetAssigned( st );
+		}
+		return;
+	case NodeKind::If: {
+		const auto& ifs = as<IfStmt>( stmt );
+		forgetAssigned( ifs.thenBranch );
+		if ( ifs.elseBranch ) {
+			forgetAssigned( ifs.elseBranch );
+		}
+		return;
+	}
+	case NodeKind::While:
+		forgetAssigned( as<WhileStmt>( stmt ).loopBody );
+		return;
+	default:
+		return;
+	}
+}
+
+/* --------------------------------------------------------------------------------------------- */
+// # The flat AST: same walk, a folded node becomes a constant where it is
+
+void ConstantFolder::fold( FlatAst& ast )
+{
+	m_known.clear();
+	m_undo.clear();
+	for ( const NodeIndex stmt : ast.program ) {
+		foldStmt( ast, stmt );
+	}
+}
+
+void ConstantFolder::foldExpr( FlatAst& ast, const NodeIndex node )
+{
+	std::optional<int64_t> value;
+	switch ( ast.kinds[ node ] ) {
+	case NodeKind::Ident:
+		value = known( ast.c[ node ] );
+		if ( !value ) {
+			return;
+		}
+		++m_propagated;
+		break;
+	case NodeKind::Binary: {
+		foldExpr( ast, ast.a[ node ] );
+		foldExpr( ast, ast.b[ node ] );
+		const auto l = constantOf( ast, ast.a[ node ] );
+		const auto r = constantOf( ast, ast.b[ node ] );
+		if ( !l || !r || !canFold( ast.tags[ node ], *r ) ) {
+			return;
+		}
+		value = Interpreter::binaryOp( ast.tags[ node ], *l, *r );
+		++m_folded;
+		break;
+	}
+	default:
+		return;
+	}
+
+	// rewrite the node as a literal (see the table in flatAst.hpp); types[ node ] stays.
+	// the operands it had are simply no longer reachable
+	ast.tags[ node ] = TokenType::T_EOF;
+	ast.b[ node ] = 0;
+	ast.c[ node ] = 0;
+	if ( ast.types[ node ] == TokenType::T_bool ) {
+		ast.kinds[ node ] = NodeKind::Bool;
+		ast.a[ node ] = *value != 0 ? 1 : 0;
+	} else {
+		ast.kinds[ node ] = NodeKind::Number;
+		ast.a[ node ] = static_cast<uint32_t>( ast.numbers.size() );
+		ast.numbers.push_back( *value );
+	}
+}
+
+void ConstantFolder::foldStmt( FlatAst& ast, const NodeIndex node )
+{
+	switch ( ast.kinds[ node ] ) {
+	case NodeKind::VarDecl:
+	case NodeKind::Assign:
+		foldExpr( ast, ast.b[ node ] );
+		remember( ast.c[ node ], constantOf( ast, ast.b[ node ] ) );
+		return;
+	case NodeKind::Block:
+		for ( const NodeIndex st : ast.blockStatements( node ) ) {
+			foldStmt( ast, st );
+		}
+		return;
+	case NodeKind::If: {
+		foldExpr( ast, ast.a[ node ] );
+		const size_t mark = m_undo.size();
+		foldStmt( ast, ast.b[ node ] );
+		const Changes afterThen = changedSince( mark );
+		rollback( mark );
+		if ( ast.c[ node ] != NoNode ) {
+			foldStmt( ast, ast.c[ node ] );
+		}
+		const Changes afterElse = changedSince( mark );
+		rollback( mark );
+		meet( afterThen, afterElse );
+		return;
+	}
+	case NodeKind::While: {
+		forgetAssigned( ast, ast.b[ node ] );
+		foldExpr( ast, ast.a[ node ] );
+		const size_t atTop = m_undo.size();
+		foldStmt( ast, ast.b[ node ] );
+		rollback( atTop );
+		return;
+	}
+	default:
+		return;
+	}
+}
+
+void ConstantFolder::forgetAssigned( const FlatAst& ast, const NodeIndex node )
+{
+	switch ( ast.kinds[ node ] ) {
+	case NodeKind::VarDecl:
+	case NodeKind::Assign:
+		remember( ast.c[ node ], std::nullopt );
+		return;
+	case NodeKind::Block:
+		for ( const NodeIndex st : ast.blockStatements( node ) ) {
+			forgetAssigned( ast, st );
+		}
+		return;
+	case NodeKind::If:
+		forgetAssigned( ast, ast.b[ node ] );
+		if ( ast.c[ node ] != NoNode ) {
+			forgetAssigned( ast, ast.c[ node ] );
+		}
+		return;
+	case NodeKind::While:
+		forgetAssigned( ast, ast.b[ node ] );
+		return;
+	default:
+		return;
+	}
+}
@@ -0,0 +1,492 @@
+// src\deadCode.cpp
+#include "headers/deadCode.hpp"
+#include "headers/parser.hpp"
+#include "headers/tokeniser.hpp"
+
+namespace
+{
+
+// # Node counts (what removing a statement takes out of the program)
+
+size_t nodeCount( const Expr* expr )
+{
+	if ( expr->kind == NodeKind::Binary ) {
+		const auto& bin = as<BinaryExpr>( expr );
+		return 1 + nodeCount( bin.left ) + nodeCount( bin.right );
+	}
+	return 1;
+}
+
+size_t nodeCount( const Stmt* stmt )
+{
+	switch ( stmt->kind ) {
+	case NodeKind::VarDecl:
+		return 1 + nodeCount( as<VarDeclStmt>( stmt ).expr );
+	case NodeKind::Assign:
+		return 1 + nodeCount( as<AssignStmt>( stmt ).value );
+	case NodeKind::Block: {
+		size_t count = 1;
+		for ( const Stmt* st : as<BlockStmt>( stmt ).statements ) {
+			count += nodeCount( st );
+		}
+		return count;
+	}
+	case NodeKind::If: {
+		const auto& ifs = as<IfStmt>( stmt );
+		return 1 + nodeCount( ifs.condition ) + nodeCount( ifs.thenBranch ) +
+				 ( ifs.elseBranch ? nodeCount( ifs.elseBranch ) : 0 );
+	}
+	case NodeKind::While: {
+		const auto& w = as<WhileStmt>( stmt );
+		return 1 + nodeCount( w.condition ) + nodeCount( w.loopBody );
+	}
+	default:
+		return 1;
+	}
+}
+
+size_t nodeCount( const FlatAst& ast, const NodeIndex node )
+{
+	switch ( ast.kinds[ node ] ) {
+	case NodeKind::Binary:
+	case NodeKind::While:
+		return 1 + nodeCount( ast, ast.a[ node ] ) + nodeCount( ast, ast.b[ node ] );
+	case NodeKind::VarDecl:
+	case NodeKind::Assign:
+		return 1 + nodeCount( ast, ast.b[ node ] );
+	case NodeKind::Block: {
+		size_t count = 1;
+		for ( const NodeIndex st : ast.blockStatements( node ) ) {
+			count += nodeCount( ast, st );
+		}
+		return count;
+	}
+	case NodeKind::If:
+		return 1 + nodeCount( ast, ast.a[ node ] ) + nodeCount( ast, ast.b[ node ] ) +
+				 ( ast.c[ node ] != NoNode ? nodeCount( ast, ast.c[ node ] ) : 0 );
+	default:
+		return 1;
+	}
+}
+
+// # Can working this out fail at run time?
+// the only thing in Carp that can is a division by zero. a store of such a value has to stay
+// even if nobody reads it, or the error would go with it
+
+bool canFail( const Expr* expr )
+{
+	if ( expr->kind != NodeKind::Binary ) {
+		return false;
+	}
+	const auto& bin = as<BinaryExpr>( expr );
+	if ( bin.operatr == TokenType::T_slash &&
+		  !( bin.right->kind == NodeKind::Number && as<NumberExpr>( bin.right ).value != 0 ) ) {
+		return true;
+	}
+	return canFail( bin.left ) || canFail( bin.right );
+}
+
+bool canFail( const FlatAst& ast, const NodeIndex node )
+{
+	if ( ast.kinds[ node ] != NodeKind::Binary ) {
+		return false;
+	}
+	const NodeIndex right = ast.b[ node ];
+	if ( ast.tags[ node ] == TokenType::T_slash &&
+		  !( ast.kinds[ right ] == NodeKind::Number && ast.numbers[ ast.a[ right ] ] != 0 ) ) {
+		return true;
+	}
+	return canFail( ast, ast.a[ node ] ) || canFail( ast, right );
+}
+
+// what a condition the folder left as a literal says: 1 true, 0 false, -1 not known yet
+int knownCondition( const Expr* cond )
+{
+	return cond->kind == NodeKind::Bool ? as<BoolExpr>( cond ).value : -1;
+}
+
+int knownCondition( const FlatAst& ast, const NodeIndex cond )
+{
+	return ast.kinds[ cond ] == NodeKind::Bool ? static_cast<int>( ast.a[ cond ] ) : -1;
+}
+
+}	// namespace
+
+/* --------------------------------------------------------------------------------------------- */
+// # The pointer tree
+
+void DeadCodeEliminator::run( CompilationUnit& unit )
+{
+	m_arena = &unit.arena;
+	m_reads.clear();
+	m_stored.clear();
+	for ( const Stmt* stmt : unit.program ) {
+		countReads( stmt );
+		if ( stmt->kind == NodeKind::VarDecl ) {
+			countRead( as<VarDeclStmt>( stmt ).slot );  // printed after the run
+		}
+	}
+	for ( Slot slot = 0; slot < m_reads.size(); ++slot ) {
+		if ( m_reads[ slot ] == 0 ) {
+			m_unread.push_back( slot );
+		}
+	}
+	dropStores();
+
+	// the counts are final now: one walk takes out the dead branches and every store whose slot
+	// ended up unread. keep what survives, in order, at the front
+	size_t kept = 0;
+	for ( Stmt* stmt : unit.program ) {
+		if ( Stmt* survivor = prune( stmt ) ) {
+			unit.program[ kept++ ] = survivor;
+		}
+	}
+	unit.program.resize( kept );
+}
+
+void DeadCodeEliminator::countRead( const Slot slot )
+{
+	if ( slot >= m_reads.size() ) {
+		m_reads.resize( slot + 1 );
+	}
+	++m_reads[ slot ];
+}
+
+void DeadCodeEliminator::countReads( const Expr* expr )
+{
+	if ( expr->kind == NodeKind::Ident ) {
+		countRead( as<IdentExpr>( expr ).slot );
+	} else if ( expr->kind == NodeKind::Binary ) {
+		countReads( as<BinaryExpr>( expr ).left );
+		countReads( as<BinaryExpr>( expr ).right );
+	}
+}
+
+void DeadCodeEliminator::countReads( const Stmt* stmt )
+{
+	// a store is remembered by its slot, which gets a count too (of 0 if nobody reads it)
+	const auto store = [ & ]( const Slot slot, const Expr* value ) {
+		if ( slot >= m_reads.size() ) {
+			m_reads.resize( slot + 1 );
+		}
+		if ( slot >= m_stored.size() ) {
+			m_stored.resize( slot + 1 );
+		}
+		m_stored[ slot ].push_back( value );
+		countReads( value );
+	};
+
+	switch ( stmt->kind ) {
+	case NodeKind::VarDecl:
+		store( as<VarDeclStmt>( stmt ).slot, as<VarDeclStmt>( stmt ).expr );
+		return;
+	case NodeKind::Assign:
+		store( as<AssignStmt>( stmt ).slot, as<AssignStmt>( stmt ).value );
+		return;
+	case NodeKind::Block:
+		for ( const Stmt* st : as<BlockStmt>( stmt ).statements ) {
+			countReads( st );
+		}
+		return;
+	case NodeKind::If: {
+		const auto& ifs = as<IfStmt>( stmt );
+		// a known condition is a literal (no reads), and only the branch it takes is kept
+		if ( const int cond = knownCondition( ifs.condition ); cond != -1 ) {
+			if ( const Stmt* taken = cond ? ifs.thenBranch : ifs.elseBranch ) {
+				countReads( taken );
+			}
+			return;
+		}
+		countReads( ifs.condition );
+		countReads( ifs.thenBranch );
+		if ( ifs.elseBranch ) {
+			countReads( ifs.elseBranch );
+		}
+		return;
+	}
+	case NodeKind::While:
+		if ( knownCondition( as<WhileStmt>( stmt ).condition ) == 0 ) {
+			return;	// never runs, goes entirely
+		}
+		countReads( as<WhileStmt>( stmt ).condition );
+		countReads( as<WhileStmt>( stmt ).loopBody );
+		return;
+	default:
+		return;
+	}
+}
+
+void DeadCodeEliminator::dropStores()
+{
+	while ( !m_unread.empty() ) {
+		const Slot slot = m_unread.back();
+		m_unread.pop_back();
+		if ( slot >= m_stored.size() ) {
+			continue;
+		}
+		// the same test prune() makes: a value that can fail stays, and so do its reads
+		for ( const Expr* value : m_stored[ slot ] ) {
+			if ( !canFail( value ) ) {
+				dropReads( value );
+			}
+		}
+	}
+}
+
+void DeadCodeEliminator::dropReads( const Expr* expr )
+{
+	if ( expr->kind == NodeKind::Ident ) {
+		if ( --m_reads[ as<IdentExpr>( expr ).slot ] == 0 ) {
+			m_unread.push_back( as<IdentExpr>( expr ).slot );
+		}
+	} else if ( expr->kind == NodeKind::Binary ) {
+		dropReads( as<BinaryExpr>( expr ).left );
+		dropReads( as<BinaryExpr>( expr ).right );
+	}
+}
+
+Stmt* DeadCodeEliminator::prune( Stmt* stmt )
+{
+	// a store is dead when its slot is never read (and the value can't fail)
+	const auto deadStore = [ & ]( const Slot slot, const Expr* value ) {
+		return ( slot >= m_reads.size() || m_reads[ slot ] == 0 ) && !canFail( value );
+	};
+
+	switch ( stmt->kind ) {
+	case NodeKind::VarDecl:
+	case NodeKind::Assign: {
+		const bool dead = stmt->kind == NodeKind::VarDecl
+									? deadStore( as<VarDeclStmt>( stmt ).slot, as<VarDeclStmt>( stmt ).expr )
+									: deadStore( as<AssignStmt>( stmt ).slot, as<AssignStmt>( stmt ).value );
+		if ( dead ) {
+			m_removed += nodeCount( stmt );
+			return nullptr;
+		}
+		return stmt;
+	}
+	case NodeKind::Block: {
+		// the statements are an array in the arena: the survivors move up, the span shrinks
+		auto& block = as<BlockStmt>( stmt );
+		size_t kept = 0;
+		for ( Stmt* st : block.statements ) {
+			if ( Stmt* survivor = prune( st ) ) {
+				block.statements[ kept++ ] = survivor;
+			}
+		}
+		block.statements = block.statements.first( kept );
+		return stmt;
+	}
+	case NodeKind::If: {
+		auto& ifs = as<IfStmt>( stmt );
+		const int cond = knownCondition( ifs.condition );
+		if ( cond != -1 ) {
+			// only the branch that runs is left, in place of the whole if
+			Stmt* taken = cond ? ifs.thenBranch : ifs.elseBranch;
+			Stmt* dropped = cond ? ifs.elseBranch : ifs.thenBranch;
+			m_removed += 1 + nodeCount( ifs.condition ) + ( dropped ? nodeCount( dropped ) : 0 );
+			return taken ? prune( taken ) : nullptr;
+		}
+		ifs.thenBranch = pruneBranch( ifs.thenBranch );
+		if ( ifs.elseBranch ) {
+			ifs.elseBranch = pruneBranch( ifs.elseBranch );
+		}
+		return stmt;
+	}
+	case NodeKind::While: {
+		auto& w = as<WhileStmt>( stmt );
+		if ( knownCondition( w.condition ) == 0 ) {
+			m_removed += nodeCount( stmt );  // never runs
+			return nullptr;
+		}
+		w.loopBody = pruneBranch( w.loopBody );
+		return stmt;
+	}
+	default:
+		return stmt;
+	}
+}
+
+Stmt* DeadCodeEliminator::pruneBranch( Stmt* stmt )
+{
+	if ( Stmt* survivor = prune( stmt ) ) {
+		return survivor;
+	}
+	// `if ( c ) unused = 1;` still needs a then branch: an empty block
+	auto* empty = m_arena->make<BlockStmt>();
+	empty->m_loc = stmt->m_loc;
+	--m_removed;  // the block is a node too
+	return empty;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+// # The flat AST: the same walk. block lists shrink in place, removed nodes stay in the arrays
+// but nothing points at them any more
+
+void DeadCodeEliminator::run( FlatAst& ast )
+{
+	m_reads.clear();
+	m_storedNodes.clear();
+	for ( const NodeIndex stmt : ast.program ) {
+		countReads( ast, stmt );
+		if ( ast.kinds[ stmt ] == NodeKind::VarDecl ) {
+			countRead( ast.c[ stmt ] );
+		}
+	}
+	for ( Slot slot = 0; slot < m_reads.size(); ++slot ) {
+		if ( m_reads[ slot ] == 0 ) {
+			m_unread.push_back( slot );
+		}
+	}
+	dropStores( ast );
+
+	size_t kept = 0;
+	for ( const NodeIndex stmt : ast.program ) {
+		if ( const NodeIndex survivor = prune( ast, stmt ); survivor != NoNode ) {
+			ast.program[ kept++ ] = survivor;
+		}
+	}
+	ast.program.resize( kept );
+}
+
+void DeadCodeEliminator::countReads( const FlatAst& ast, const NodeIndex node )
+{
+	switch ( ast.kinds[ node ] ) {
+	case NodeKind::Ident:
+		countRead( ast.c[ node ] );
+		return;
+	case NodeKind::Binary:
+		countReads( ast, ast.a[ node ] );
+		countReads( ast, ast.b[ node ] );
+		return;
+	case NodeKind::While:
+		if ( knownCondition( ast, ast.a[ node ] ) == 0 ) {
+			return;
+		}
+		countReads( ast, ast.a[ node ] );
+		countReads( ast, ast.b[ node ] );
+		return;
+	case NodeKind::VarDecl:
+	case NodeKind::Assign: {
+		const Slot slot = ast.c[ node ];
+		if ( slot >= m_reads.size() ) {
+			m_reads.resize( slot + 1 );
+		}
+		if ( slot >= m_storedNodes.size() ) {
+			m_storedNodes.resize( slot + 1 );
+		}
+		m_storedNodes[ slot ].push_back( ast.b[ node ] );
+		countReads( ast, ast.b[ node ] );
+		return;
+	}
+	case NodeKind::Block:
+		for ( const NodeIndex st : ast.blockStatements( node ) ) {
+			countReads( ast, st );
+		}
+		return;
+	case NodeKind::If:
+		if ( const int cond = knownCondition( ast, ast.a[ node ] ); cond != -1 ) {
+			if ( const NodeIndex taken = cond ? ast.b[ node ] : ast.c[ node ]; taken != NoNode ) {
+				countReads( ast, taken );
+			}
+			return;
+		}
+		countReads( ast, ast.a[ node ] );
+		countReads( ast, ast.b[ node ] );
+		if ( ast.c[ node ] != NoNode ) {
+			countReads( ast, ast.c[ node ] );
+		}
+		return;
+	default:
+		return;
+	}
+}
+
+void DeadCodeEliminator::dropStores( const FlatAst& ast )
+{
+	while ( !m_unread.empty() ) {
+		const Slot slot = m_unread.back();
+		m_unread.pop_back();
+		if ( slot >= m_storedNodes.size() ) {
+			continue;
+		}
+		for ( const NodeIndex value : m_storedNodes[ slot ] ) {
+			if ( !canFail( ast, value ) ) {
+				dropReads( ast, value );
+			}
+		}
+	}
+}
+
+void DeadCodeEliminator::dropReads( const FlatAst& ast, const NodeIndex node )
+{
+	if ( ast.kinds[ node ] == NodeKind::Ident ) {
+		if ( --m_reads[ ast.c[ node ] ] == 0 ) {
+			m_unread.push_back( ast.c[ node ] );
+		}
+	} else if ( ast.kinds[ node ] == NodeKind::Binary ) {
+		dropReads( ast, ast.a[ node ] );
+		dropReads( ast, ast.b[ node ] );
+	}
+}
+
+NodeIndex DeadCodeEliminator::prune( FlatAst& ast, const NodeIndex node )
+{
+	switch ( ast.kinds[ node ] ) {
+	case NodeKind::VarDecl:
+	case NodeKind::Assign: {
+		const Slot slot = ast.c[ node ];
+		if ( ( slot >= m_reads.size() || m_reads[ slot ] == 0 ) && !canFail( ast, ast.b[ node ] ) ) {
+			m_removed += nodeCount( ast, node );
+			return NoNode;
+		}
+		return node;
+	}
+	case NodeKind::Block: {
+		// the block's run in `lists`: survivors move to the front, the count shrinks
+		const uint32_t first = ast.a[ node ];
+		uint32_t kept = 0;
+		for ( uint32_t i = 0; i < ast.b[ node ]; ++i ) {
+			const NodeIndex survivor = prune( ast, ast.lists[ first + i ] );
+			if ( survivor != NoNode ) {
+				ast.lists[ first + kept++ ] = survivor;
+			}
+		}
+		ast.b[ node ] = kept;
+		return node;
+	}
+	case NodeKind::If: {
+		const int cond = knownCondition( ast, ast.a[ node ] );
+		if ( cond != -1 ) {
+			const NodeIndex taken = cond ? ast.b[ node ] : ast.c[ node ];
+			const NodeIndex dropped = cond ? ast.c[ node ] : ast.b[ node ];
+			m_removed += 1 + nodeCount( ast, ast.a[ node ] ) +
+							 ( dropped != NoNode ? nodeCount( ast, dropped ) : 0 );
+			return taken != NoNode ? prune( ast, taken ) : NoNode;
+		}
+		ast.b[ node ] = pruneBranch( ast, ast.b[ node ] );
+		if ( ast.c[ node ] != NoNode ) {
+			ast.c[ node ] = pruneBranch( ast, ast.c[ node ] );
+		}
+		return node;
+	}
+	case NodeKind::While:
+		if ( knownCondition( ast, ast.a[ node ] ) == 0 ) {
+			m_removed += nodeCount( ast, node );
+			return NoNode;
+		}
+		ast.b[ node ] = pruneBranch( ast, ast.b[ node ] );
+		return node;
+	default:
+		return node;
+	}
+}
+
+NodeIndex DeadCodeEliminator::pruneBranch( FlatAst& ast, const NodeIndex node )
+{
+	if ( const NodeIndex survivor = prune( ast, node ); survivor != NoNode ) {
+		return survivor;
+	}
+	--m_removed;
+	return ast.add( NodeKind::Block, TokenType::T_EOF, static_cast<uint32_t>( ast.lists.size() ), 0,
+						 0, ast.locs[ node ] );
+}
@@ -0,0 +1,193 @@
+// src\flatAst.cpp
+#include "headers/flatAst.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include "headers/utils.hpp"
+
+NodeIndex FlatAst::add( const NodeKind kind, const TokenType tag, const uint32_t first,
+								const uint32_t second, const uint32_t third, const Location loc )
+{
+	const auto node = static_cast<NodeIndex>( kinds.size() );
+	kinds.push_back( kind );
+	tags.push_back( tag );
+	a.push_back( first );
+	b.push_back( second );
+	c.push_back( third );
+	locs.push_back( loc );
+	types.push_back( TokenType::T_EOF );
+	return node;
+}
+
+size_t FlatAst::bytesUsed() const
+{
+	return kinds.size() * sizeof( NodeKind ) +
+			 ( tags.size() + types.size() ) * sizeof( TokenType ) +
+			 ( a.size() + b.size() + c.size() ) * sizeof( uint32_t ) + locs.size() * sizeof( Location ) +
+			 numbers.size() * sizeof( int64_t ) +
+			 ( literals.size() + names.size() ) * sizeof( std::string_view ) +
+			 ( lists.size() + program.size() ) * sizeof( NodeIndex );
+}
+
+Slot FlatAst::frameSize() const
+{
+	Slot size = 0;
+	for ( NodeIndex node = 0; node < kinds.size(); ++node ) {
+		if ( kinds[ node ] == NodeKind::VarDecl && c[ node ] != NoSlot ) {
+			size = std::max( size, c[ node ] + 1 );
+		}
+	}
+	return size;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+// # Printing: mirrors the print() of every node struct in parser.hpp, line for line
+
+void FlatAst::print( const NodeIndex node, const int indentLevel ) const
+{
+	indent( indentLevel );
+	switch ( kinds[ node ] ) {
+	case NodeKind::Number:
+		std::cout << "NumberExpr(" << YELLOW << numbers[ a[ node ] ] << CoRESET << ")\n";
+		return;
+	case NodeKind::String:
+		std::cout << "StringExpr(\"" << YELLOW << literals[ a[ node ] ] << CoRESET << "\")\n";
+		return;
+	case NodeKind::Bool:
+		std::cout << "BoolExpr(\"" << YELLOW << ( a[ node ] ? "true" : "false" ) << CoRESET << "\")\n";
+		return;
+	case NodeKind::Ident:
+		std::cout << "IdentExpr(" << YELLOW << name( node ) << CoRESET << ")\n";
+		return;
+	case NodeKind::Binary:
+		std::cout << "BinaryExpr(" << BLUE << tokenTypeToString( tags[ node ] ) << CoRESET << ")\n";
+		print( a[ node ], indentLevel + 1 );
+		print( b[ node ], indentLevel + 1 );
+		return;
+
+	case NodeKind::VarDecl:
+		std::cout << "VarDeclStmt\n";
+		indent( indentLevel + 1 );
+		std::cout << "type: " << BLUE << tokenTypeToString( tags[ node ] ) << CoRESET << "\n";
+		indent( indentLevel + 1 );
+		std::cout << "name: " << GREEN << name( node ) << CoRESET << "\n";
+		indent( indentLevel + 1 );
+		std::cout << "initExpr:\n";
+		print( b[ node ], indentLevel + 2 );
+		return;
+	case NodeKind::Assign:
+		std::cout << "AssignStmt\n";
+		indent( indentLevel + 1 );
+		std::cout << "name: " << GREEN << name( node ) << CoRESET << "\n";
+		indent( indentLevel + 1 );
+		std::cout << "value:\n";
+		print( b[ node ], indentLevel + 2 );
+		return;
+	case NodeKind::If:
+		std::cout << "IfStmt\n";
+		indent( indentLevel + 1 );
+		std::cout << "condition:\n";
+		print( a[ node ], indentLevel + 2 );
+		indent( indentLevel + 1 );
+		std::cout << "then:\n";
+		print( b[ node ], indentLevel + 2 );
+		if ( c[ node ] != NoNode ) {
+			indent( indentLevel + 1 );
+			std::cout << "else:" << '\n';
+			print( c[ node ], indentLevel + 2 );
+		}
+		return;
+	case NodeKind::Block:
+		std::cout << "BlockStmt" << '\n';
+		for ( const NodeIndex st : blockStatements( node ) ) {
+			print( st, indentLevel + 1 );
+		}
+		return;
+	case NodeKind::While:
+		std::cout << "WhileLoopStmt:\n";
+		indent( indentLevel + 1 );
+		std::cout << "condition:\n";
+		print( a[ node ], indentLevel + 2 );
+		indent( indentLevel + 1 );
+		std::cout << "body:\n";
+		print( b[ node ], indentLevel + 2 );
+		return;
+	}
+}
+
+/* --------------------------------------------------------------------------------------------- */
+// # Building
+
+NodeIndex FlatBuilder::number( const int64_t value, const Location l )
+{
+	ast.numbers.push_back( value );
+	return ast.add( NodeKind::Number, TokenType::T_EOF,
+						 static_cast<uint32_t>( ast.numbers.size() - 1 ), 0, 0, l );
+}
+
+NodeIndex FlatBuilder::string( const std::string_view text, const Location l )
+{
+	ast.literals.push_back( text );
+	return ast.add( NodeKind::String, TokenType::T_EOF,
+						 static_cast<uint32_t>( ast.literals.size() - 1 ), 0, 0, l );
+}
+
+NodeIndex FlatBuilder::boolean( const bool value, const Location l )
+{
+	return ast.add( NodeKind::Bool, TokenType::T_EOF, value, 0, 0, l );
+}
+
+NodeIndex FlatBuilder::ident( const std::string_view name, const SymbolId sym, const Location l )
+{
+	rememberName( sym, name );
+	return ast.add( NodeKind::Ident, TokenType::T_EOF, sym, 0, NoSlot, l );
+}
+
+NodeIndex FlatBuilder::binary( const NodeIndex left, const TokenType op, const NodeIndex right,
+										 const Location l )
+{
+	return ast.add( NodeKind::Binary, op, left, right, 0, l );
+}
+
+NodeIndex FlatBuilder::varDecl( const TokenType type, const std::string_view name,
+										  const SymbolId sym, const NodeIndex init, const Location l )
+{
+	rememberName( sym, name );
+	return ast.add( NodeKind::VarDecl, type, sym, init, NoSlot, l );
+}
+
+NodeIndex FlatBuilder::assign( const std::string_view name, const SymbolId sym,
+										 const NodeIndex value, const Location l )
+{
+	rememberName( sym, name );
+	return ast.add( NodeKind::Assign, TokenType::T_EOF, sym, value, NoSlot, l );
+}
+
+NodeIndex FlatBuilder::ifStmt( const NodeIndex cond, const NodeIndex thenBranch,
+										 const NodeIndex elseBranch, const Location l )
+{
+	return ast.add( NodeKind::If, TokenType::T_EOF, cond, thenBranch, elseBranch, l );
+}
+
+NodeIndex FlatBuilder::whileStmt( const NodeIndex cond, const NodeIndex body, const Location l )
+{
+	return ast.add( NodeKind::While, TokenType::T_EOF, cond, body, 0, l );
+}
+
+NodeIndex FlatBuilder::block( const std::span<const NodeIndex> statements, const Location l )
+{
+	const auto first = static_cast<uint32_t>( ast.lists.size() );
+	ast.lists.insert( ast.lists.end(), statements.begin(), statements.end() );
+	return ast.add( NodeKind::Block, TokenType::T_EOF, first,
+						 static_cast<uint32_t>( statements.size() ), 0, l );
+}
+
+// ids are dense, so the name table is just filled in as ids show up
+void FlatBuilder::rememberName( const SymbolId sym, const std::string_view name )
+{
+	if ( sym >= ast.names.size() ) {
+		ast.names.resize( sym + 1 );
+	}
+	ast.names[ sym ] = name;
+}
@@ -1,50 +1,92 @@
 // src\headers\SemanticAnalyser.hpp
 #pragma once
 
-#include <unordered_map>
+#include <cstdint>
+#include <string_view>
+#include <vector>
 
+#include "flatAst.hpp"
 #include "parser.hpp"
 
 // to store info about a var
 struct Symbol {
-	TokenType tType;	// currently we only have its type
+	TokenType tType;		// its type
+	Slot slot;				// where the interpreter keeps it
+	uint32_t depth = 0;	// how many scopes deep it was declared (global = 1), 0 = not declared
 };
 
-// everything within a {} - multiple can exist in one file
-struct Scope {
-	std::unordered_map<std::string, Symbol> symbols;
+// one entry of the undo log: a declaration replaced `previous` as the binding of `id`
+// (previous.depth is 0 if nothing of that name was visible before)
+struct Shadowed {
+	SymbolId id;
+	Symbol previous;
+};
 
-	/* This map says:
-	"x"   → Symbol{ int }
-	"msg" → Symbol{ string }
-	*/
+// everything within a {} - multiple can exist in one file.
+// a scope owns no table of its own, it only remembers where it started
+struct ScopeMark {
+	size_t undoSize;	 // m_undo.size() when the scope was entered
+	Slot firstSlot;	 // the slots this scope's variables took start here
 };
 
 class SemanticAnalyser {
  public:
-	SemanticAnalyser();
-	void analyse( const std::vector<std::unique_ptr<Stmt>>& program );
+	// `lines` turns node offsets back into line:column for the error messages
+	explicit SemanticAnalyser( const LineTable& lines );
+	// checks the program and resolves it: every variable gets a slot, written onto each node
+	// that declares, reads or assigns it, and every expression gets its type written onto it
+	// (that's why the AST isn't const)
+	void analyse( const std::vector<Stmt*>& program );
+	void analyse( FlatAst& ast );	// same rules and messages, on the flat AST
+
+	// how many slots the resolved program needs at most at once
+	[[nodiscard]] Slot frameSize() const { return m_frameSize; }
 
  private:
-	std::vector<Scope> scopeStack;  // to keep track of all the scopes in order
+	const LineTable& m_lines;
+	Slot m_nextSlot = 0;		// the next free slot
+	Slot m_frameSize = 0;	// the most slots in use at any point
 
-	/* example stack
-	global scope
-		└─ if scope
-			└─ while scope
+	// one flat table for every scope: what each name means right now, by SymbolId.
+	// a declaration overwrites the entry and logs what was there in m_undo; leaving a scope
+	// replays the log back to its mark. so a lookup is one index however deep the nesting is,
+	// and entering or leaving a block allocates nothing
+	std::vector<Symbol> m_bindings;
+	std::vector<Shadowed> m_undo;
+	std::vector<ScopeMark> m_scopes;	// innermost last
+
+	/* example (type@depth)
+		int x;          bindings[x] = int@1      undo: [x was nothing]
+		{               mark: undo size 1
+			string x;    bindings[x] = string@2   undo: [x was nothing, x was int@1]
+		}               undo back to size 1:     bindings[x] = int@1
 	*/
 
 	void enterScope();
 	void exitScope();
 
-	void visitStmt( const Stmt* stmt );
-	TokenType visitExpr( const Expr* expr );
+	void visitStmt( Stmt* stmt );
+	void visitBody( Stmt* body );	 // an if/while body, in a scope of its own
+	TokenType visitExpr( Expr* expr );	 // inferType, and records the answer on the node
+	TokenType inferType( Expr* expr );
+
+	// the flat AST versions
+	void visitStmt( FlatAst& ast, NodeIndex node );
+	void visitBody( FlatAst& ast, NodeIndex body );
+	TokenType visitExpr( FlatAst& ast, NodeIndex node );	// records it in ast.types
+	TokenType inferType( FlatAst& ast, NodeIndex node );
+
+	// the operand rules of every binary operator, shared by both walks
+	TokenType binaryType( TokenType op, TokenType leftType, TokenType rightType,
+								 const Location& loc ) const;
 
-	void declare( const std::string& name, TokenType type );
-	Symbol* lookup( const std::string& name );
+	// `name` is only there for the error message, the id is what gets compared.
+	// returns the slot the new variable got
+	Slot declare( SymbolId id, std::string_view name, TokenType type );
+	Symbol* lookup( SymbolId id );
 
 
    [[noreturn]]
-   static void error( const Location& loc, const std::string& msg );
+   void error( const Location& loc, const std::string& msg ) const;
 
 };
@@ -0,0 +1,61 @@
+// src\headers\arena.hpp
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator: hands out memory from big blocks by moving a pointer forward, and gives all
+// of it back at once when the arena goes away. Nothing is freed one by one and no destructor
+// ever runs, so only trivially destructible types may live here (checked at compile time).
+// Objects come out in the order they are made, which for the AST means parse order.
+class Arena {
+ public:
+	Arena() = default;
+	~Arena() = default;	// frees the blocks, which is all the "teardown" there is
+
+	// the objects inside point at each other, so the arena must stay where it is
+	Arena( const Arena& ) = delete;
+	Arena& operator=( const Arena& ) = delete;
+
+	// constructs a T in the arena
+	template <typename T, typename... Args>
+	T* make( Args&&... args )
+	{
+		static_assert( std::is_trivially_destructible_v<T>, "arena objects are never destroyed" );
+		return ::new ( allocate( sizeof( T ), alignof( T ) ) ) T( std::forward<Args>( args )... );
+	}
+
+	// copies `items` into the arena, e.g. a block's statement list once it is complete
+	template <typename T>
+	std::span<T> copyArray( const std::span<const T> items )
+	{
+		static_assert( std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T> );
+		if ( items.empty() ) {
+			return {};
+		}
+		T* out = static_cast<T*>( allocate( items.size_bytes(), alignof( T ) ) );
+		std::uninitialized_copy( items.begin(), items.end(), out );
+		return { out, items.size() };
+	}
+
+	void* allocate( size_t bytes, size_t align );
+
+	[[nodiscard]] size_t bytesUsed() const { return m_used; }	 // handed out so far
+
+ private:
+	void grow( size_t minBytes );
+
+	static constexpr size_t FirstBlockBytes = 64 * 1024;
+	static constexpr size_t MaxBlockBytes = 4 * 1024 * 1024;	// blocks double up to this
+
+	std::vector<std::unique_ptr<std::byte[]>> m_blocks;
+	std::byte* m_next = nullptr;	// next free byte in the current block
+	std::byte* m_end = nullptr;	// end of the current block
+	size_t m_nextBlockBytes = FirstBlockBytes;
+	size_t m_used = 0;
+};
@@ -0,0 +1,44 @@
+// src\headers\astCache.hpp
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "flatAst.hpp"
+
+// Precompiled AST cache (.carpc)
+// A checked FlatAst written to disk, so running an unchanged file again can skip the tokeniser,
+// the parser and the semantic analyser. The file is:
+//   a header: magic, format version, compiler id, the source's size and content hash, and how
+//             many entries each FlatAst array has
+//   the arrays themselves, back to back, each starting on an 8 byte boundary
+// Everything is an index or an offset (names and literals are offset + length into the source,
+// which the hash pins down), so the file means the same wherever it is mapped.
+// It is loaded by mapping the file and copying each array in one go: a handful of allocations
+// however big the program is, none per node.
+namespace astcache
+{
+
+// bump this whenever FlatAst's arrays, NodeKind or what a node's fields mean change
+inline constexpr uint32_t FormatVersion = 3;	// 2: resolved slots in c, 3: types
+
+// 64-bit hash of the source text, the cache key (fast, not cryptographic)
+uint64_t contentHash( std::string_view text );
+
+// where the cache for `sourcePath` lives: `<sourcePath>c` next to it (main.carp -> main.carpc),
+// or `<cacheDir>/<content hash>.carpc` when a cache directory is given
+std::string pathFor( const std::string& sourcePath, const std::string& cacheDir,
+							std::string_view source );
+
+// fills `out` from the cache at `path` and returns true, or returns false (leaving `out` empty)
+// when there is no cache, or it was made from other source text, by another compiler version,
+// or is damaged. `source` must be the text the AST will be used with
+bool load( const std::string& path, std::string_view source, FlatAst& out );
+
+// writes `ast`, which must have been parsed from `source` and checked without errors.
+// goes through a temporary file and a rename, so a reader never sees half a cache.
+// throws std::runtime_error if the file can't be written
+void save( const std::string& path, std::string_view source, const FlatAst& ast );
+
+}	// namespace astcache
@@ -0,0 +1,16 @@
+// src\headers\compilationUnit.hpp
+#pragma once
+
+#include <vector>
+
+#include "arena.hpp"
+
+struct Stmt;
+
+// Everything the parser builds for one source file.
+// All the nodes live in `arena`, so the whole tree goes away in one go with the unit: no
+// recursive destructors, no per-node frees. Node pointers stay valid exactly as long as it does.
+struct CompilationUnit {
+	Arena arena;
+	std::vector<Stmt*> program;  // top-level statements in source order
+};
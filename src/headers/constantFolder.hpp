@@ -0,0 +1,66 @@
+// src\headers\constantFolder.hpp
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "compilationUnit.hpp"
+#include "flatAst.hpp"
+#include "parser.hpp"
+
+// Constant folding and propagation (-O1), run after the semantic analyser: it needs the types
+// and slots the analyser wrote onto the AST.
+//   folding:      a BinaryExpr whose operands are both constants becomes one constant,
+//                 `x = 5 + 3 * 2;` -> `x = 11;` (so does the `0 - expr` a unary minus makes)
+//   propagation:  a variable read whose value is known becomes that value,
+//                 `int a = 4; int b = a * 2;` -> `int b = 8;`
+// The result is worked out with Interpreter::binaryOp, so ints wrap on overflow exactly like
+// they would at run time. A division by zero is left alone: it still fails when it runs.
+class ConstantFolder {
+ public:
+	void fold( CompilationUnit& unit );	 // the new constants are made in unit.arena
+	void fold( FlatAst& ast );				 // the same, rewriting the nodes in place
+
+	[[nodiscard]] size_t foldedCount() const { return m_folded; }				// operators worked out
+	[[nodiscard]] size_t propagatedCount() const { return m_propagated; }	// reads replaced
+
+ private:
+	// what each slot holds at this point of the walk, by slot (ints, and bools as 0/1).
+	// nothing for a slot that isn't known, or holds a string
+	using Known = std::vector<std::optional<int64_t>>;
+	Known m_known;
+	size_t m_folded = 0;
+	size_t m_propagated = 0;
+
+	// every write to m_known, with what the slot held before: going back to an earlier size of
+	// the log puts back what was known there, so a branch costs what it assigns, not a copy of
+	// every slot (the same idea as the SemanticAnalyser's scopes)
+	struct Overwritten {
+		Slot slot;
+		std::optional<int64_t> previous;
+	};
+	std::vector<Overwritten> m_undo;
+	// the slots written since a mark and what they hold now, by slot, each once
+	using Changes = std::vector<std::pair<Slot, std::optional<int64_t>>>;
+
+	void remember( Slot slot, std::optional<int64_t> value );
+	std::optional<int64_t> known( Slot slot ) const;
+	void rollback( size_t mark );
+	Changes changedSince( size_t mark ) const;
+	// after an if, from what was known before it: only what both branches agree on is still known
+	void meet( const Changes& afterThen, const Changes& afterElse );
+
+	// tree: foldExpr returns what should replace `expr` in its parent (`expr` if nothing changed)
+	Arena* m_arena = nullptr;	 // where the new constants go
+	void foldStmt( Stmt* stmt );
+	Expr* foldExpr( Expr* expr );
+	void forgetAssigned( const Stmt* stmt );	// everything a loop body may change
+
+	// flat: a folded node is turned into a Number or Bool node where it is
+	void foldStmt( FlatAst& ast, NodeIndex node );
+	void foldExpr( FlatAst& ast, NodeIndex node );
+	void forgetAssigned( const FlatAst& ast, NodeIndex node );
+};
@@ -0,0 +1,59 @@
+// src\headers\deadCode.hpp
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "compilationUnit.hpp"
+#include "flatAst.hpp"
+#include "parser.hpp"
+
+// Dead code elimination (-O1), run after the semantic analyser and best after the
+// ConstantFolder, which turns conditions like `debug == 1` into plain true/false.
+//   dead branches:  `if ( false ) A else B` -> B, `if ( true ) A else B` -> A, and
+//                   `while ( false ) A` goes entirely
+//   dead stores:    a declaration or assignment of a variable nothing ever reads goes
+//                   (`int unused = 5;`), as long as working its value out can't fail.
+//                   the top-level variables count as read once more at the end: --run prints
+//                   them, so -O1 shows the same values as -O0
+// "Never read" is counted by slot. Sibling blocks can share a slot, so a store whose variable
+// is unread but whose slot another variable reads is kept: that only misses some, never
+// removes a store that matters.
+// Removing a store takes the reads in its value with it, which can leave other variables unread
+// in turn: reads are counted once, and those variables go on a worklist as their count drops
+// to zero, so every store is looked at once however long the chain is.
+class DeadCodeEliminator {
+ public:
+	void run( CompilationUnit& unit );	 // an emptied branch gets an empty block from unit.arena
+	void run( FlatAst& ast );
+
+	// how many nodes are no longer part of the program
+	[[nodiscard]] size_t removedCount() const { return m_removed; }
+
+ private:
+	std::vector<uint32_t> m_reads;	// by slot: how many reads of it are left in the program
+	std::vector<Slot> m_unread;		// slots whose reads just ran out, their stores still to drop
+	size_t m_removed = 0;
+
+	void countRead( Slot slot );
+
+	// tree: prune returns what should replace `stmt` in its parent, nullptr if it goes
+	Arena* m_arena = nullptr;
+	Stmt* prune( Stmt* stmt );
+	Stmt* pruneBranch( Stmt* stmt );	// the same, but never nullptr: an if or while needs a body
+	// by slot: the values stored to it (in the code that runs: dead branches are left out)
+	std::vector<std::vector<const Expr*>> m_stored;
+	void countReads( const Stmt* stmt );
+	void countReads( const Expr* expr );
+	void dropStores();	 // empties m_unread: the stores of those slots take their reads with them
+	void dropReads( const Expr* expr );	 // takes the reads back out, queues what hits zero
+
+	// flat: the same, NoNode for a statement that goes
+	NodeIndex prune( FlatAst& ast, NodeIndex node );
+	NodeIndex pruneBranch( FlatAst& ast, NodeIndex node );
+	std::vector<std::vector<NodeIndex>> m_storedNodes;	// the value nodes
+	void countReads( const FlatAst& ast, NodeIndex node );
+	void dropStores( const FlatAst& ast );
+	void dropReads( const FlatAst& ast, NodeIndex node );
+};
@@ -0,0 +1,103 @@
+// src\headers\flatAst.hpp
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "parser.hpp"
+#include "tokeniser.hpp"
+
+// The same program as the pointer tree in parser.hpp, stored data-oriented: every node is one
+// index, and what the tree keeps in each object lives in parallel arrays (struct of arrays).
+// No vtables, no pointers, ~18 bytes a node, and a pass over every node is a walk over a few
+// flat arrays. Children are always made before their parent, so node order is post-order.
+
+using NodeIndex = uint32_t;
+inline constexpr NodeIndex NoNode = UINT32_MAX;
+
+// NodeKind (parser.hpp) is shared with the pointer tree
+
+/* What a, b and c hold for each kind
+
+	Number	a = index into numbers
+	String	a = index into literals
+	Bool		a = 0 or 1
+	Ident		a = SymbolId, c = Slot
+	Binary	a = left, b = right, tag = the operator
+	VarDecl	a = SymbolId, b = initialiser, c = Slot, tag = the declared type
+	Assign	a = SymbolId, b = value, c = Slot
+	If			a = condition, b = then branch, c = else branch (NoNode if none)
+	Block		a = first entry in lists, b = statement count
+	While		a = condition, b = body
+
+	unused fields are 0, an unused tag is T_EOF.
+	a Slot is NoSlot until the semantic analyser resolves the name (see Slot in parser.hpp)
+	types[ node ] is an expression's static type (see Expr::m_type), T_EOF for statements
+*/
+struct FlatAst {
+	// # one entry per node
+	std::vector<NodeKind> kinds;
+	std::vector<TokenType> tags;
+	std::vector<uint32_t> a;
+	std::vector<uint32_t> b;
+	std::vector<uint32_t> c;
+	std::vector<Location> locs;
+	std::vector<TokenType> types;	 // filled in by the semantic analyser
+
+	// # side tables
+	std::vector<int64_t> numbers;				// number literal values
+	std::vector<std::string_view> literals;	// string literal text (views into the source)
+	std::vector<std::string_view> names;		// by SymbolId, for printing and error messages
+	std::vector<NodeIndex> lists;				// the statements of every block, one run each
+	std::vector<NodeIndex> program;				// top-level statements in source order
+
+	NodeIndex add( NodeKind kind, TokenType tag, uint32_t first, uint32_t second, uint32_t third,
+						Location loc );
+
+	[[nodiscard]] size_t size() const { return kinds.size(); }
+	[[nodiscard]] std::span<const NodeIndex> blockStatements( const NodeIndex block ) const
+	{
+		return std::span<const NodeIndex>( lists ).subspan( a[ block ], b[ block ] );
+	}
+	[[nodiscard]] std::string_view name( const NodeIndex node ) const { return names[ a[ node ] ]; }
+	[[nodiscard]] size_t bytesUsed() const;	// what the arrays above hold (not their capacity)
+	// once resolved: how many slots the program needs, one past the highest any declaration got
+	[[nodiscard]] Slot frameSize() const;
+
+	// same output as Stmt::print / Expr::print on the equivalent tree
+	void print( NodeIndex node, int indentLevel = 0 ) const;
+};
+
+// builds a FlatAst straight from the parser (see TreeBuilder in parser.hpp for the interface)
+struct FlatBuilder {
+	using Output = FlatAst;
+	using ExprRef = NodeIndex;
+	using StmtRef = NodeIndex;
+	static constexpr NodeIndex NoStmt = NoNode;
+
+	FlatAst& ast;
+
+	NodeIndex number( int64_t value, Location l );
+	NodeIndex string( std::string_view text, Location l );
+	NodeIndex boolean( bool value, Location l );
+	NodeIndex ident( std::string_view name, SymbolId sym, Location l );
+	NodeIndex binary( NodeIndex left, TokenType op, NodeIndex right, Location l );
+
+	NodeIndex varDecl( TokenType type, std::string_view name, SymbolId sym, NodeIndex init,
+							 Location l );
+	NodeIndex assign( std::string_view name, SymbolId sym, NodeIndex value, Location l );
+	NodeIndex ifStmt( NodeIndex cond, NodeIndex thenBranch, NodeIndex elseBranch, Location l );
+	NodeIndex whileStmt( NodeIndex cond, NodeIndex body, Location l );
+	NodeIndex block( std::span<const NodeIndex> statements, Location l );
+
+	[[nodiscard]] Location loc( const NodeIndex node ) const { return ast.locs[ node ]; }
+	void addTopLevel( const NodeIndex stmt ) { ast.program.push_back( stmt ); }
+
+ private:
+	void rememberName( SymbolId sym, std::string_view name );
+};
+
+// the parser that emits the flat AST
+using FlatParser = BasicParser<FlatBuilder>;
@@ -0,0 +1,30 @@
+// src\headers\interner.hpp
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// dense id of one distinct identifier: 0, 1, 2... in the order the names are first seen
+using SymbolId = uint32_t;
+inline constexpr SymbolId NoSymbol = UINT32_MAX;	// tokens that aren't identifiers
+
+// Hands out one SymbolId per distinct identifier.
+// The tokeniser interns every identifier once, so the parser, the semantic analyser and the
+// interpreter only ever compare and index by id instead of hashing strings again.
+// Names are views, not copies: like the tokens, they point into the source text, which must
+// outlive the interner.
+class Interner {
+ public:
+	// id of `name`, a new one if it hasn't been seen before
+	SymbolId intern( std::string_view name );
+	// the text an id stands for
+	[[nodiscard]] std::string_view name( const SymbolId id ) const { return m_names[ id ]; }
+	// number of ids handed out so far, a table indexed by SymbolId needs this many slots
+	[[nodiscard]] size_t size() const { return m_names.size(); }
+
+ private:
+	std::unordered_map<std::string_view, SymbolId> m_ids;
+	std::vector<std::string_view> m_names;	 // id -> name
+};
@@ -0,0 +1,42 @@
+// src\headers\lexScan.hpp
+#pragma once
+
+#include <cstddef>
+
+// Bulk scanning kernels for the tokeniser.
+// Each one takes the half-open range [p, end) and returns a pointer to the first byte that stops
+// the scan (or end if nothing does). They never read at or past end, so any string_view is safe.
+// There are SSE2 and AVX2 versions picked once at start-up from what the CPU supports, and a
+// scalar version that is used everywhere else (and on any CPU that isn't x86).
+namespace lexscan
+{
+
+enum class Level
+{
+	Scalar,
+	SSE2,
+	AVX2
+};
+
+// the best level this CPU (and build) can run
+[[nodiscard]] Level bestLevel();
+// the level the kernels below currently dispatch to (bestLevel() unless overridden)
+[[nodiscard]] Level activeLevel();
+// force a level, e.g. Scalar for benchmarks; levels the CPU can't run fall back to bestLevel()
+void setLevel( Level level );
+[[nodiscard]] const char* levelName( Level level );
+
+// skips ' ', '\t', '\r' and '\n'
+const char* skipWhitespace( const char* p, const char* end );
+// skips [A-Za-z0-9_]
+const char* skipIdentifier( const char* p, const char* end );
+// skips [0-9]
+const char* skipDigits( const char* p, const char* end );
+// finds the '\n' that ends a // comment
+const char* findLineEnd( const char* p, const char* end );
+// finds the '*' of the "*/" that closes a block comment
+const char* findBlockCommentEnd( const char* p, const char* end );
+// finds the closing '"' of a string literal, or the '\n' / '\0' that makes it unterminated
+const char* findStringEnd( const char* p, const char* end );
+
+}	// namespace lexscan
@@ -0,0 +1,37 @@
+// src\headers\location.hpp
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// where a token or node appears: just the byte offset into the source.
+// 4 bytes instead of a line and a column, and the tokeniser never has to count lines.
+// the line:column people read is worked out by LineTable, only when something gets printed
+struct Location {
+	uint32_t offset = 0;
+};
+
+// so sources must stay below 4 GB (the tokeniser checks)
+inline constexpr size_t MaxSourceBytes = UINT32_MAX;
+
+// 1-based, the way editors show it
+struct LineColumn {
+	size_t line;
+	size_t column;
+};
+
+// Turns offsets back into line:column for one source text.
+// The table of line starts is only built the first time resolve() is called, so a run that
+// prints no diagnostics never scans the text for new lines at all.
+class LineTable {
+ public:
+	explicit LineTable( std::string_view source ) : m_source( source ) {}
+
+	[[nodiscard]] LineColumn resolve( Location loc ) const;	// binary search over line starts
+
+ private:
+	std::string_view m_source;
+	mutable std::vector<uint32_t> m_lineStarts;	// offset of every line's first byte, built lazily
+};
@@ -1,35 +1,73 @@
 // src\headers\parser.hpp
 #pragma once
 
+#include <cstdint>
 #include <iostream>
-#include <memory>
+#include <span>
 #include <string>
-#include <variant>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+#include "compilationUnit.hpp"
 #include "tokeniser.hpp"
 #include "utils.hpp"
 
 /* --------------------------------------------------------------------------------------------- */
 
-using Value = std::variant<int, std::string>;
+// where a variable lives at run time: an index into the interpreter's frame.
+// the semantic analyser hands these out as it declares variables (each block's variables
+// take the slots after its parent's, and give them back at the closing brace), and writes the
+// slot onto every node that names the variable. a shadowing variable gets a slot of its own
+using Slot = uint32_t;
+inline constexpr Slot NoSlot = UINT32_MAX;	// not resolved (yet)
 
-struct Environment {
-	std::unordered_map<std::string, Value> variables;
+/* --------------------------------------------------------------------------------------------- */
+
+// what a node is. every node carries its kind, so a pass dispatches with one switch (a jump
+// table) instead of trying dynamic_cast against one type after another.
+// the flat AST (flatAst.hpp) uses the same enum
+enum class NodeKind : uint8_t
+{
+	// expressions
+	Number,
+	String,
+	Bool,
+	Ident,
+	Binary,
+	// statements
+	VarDecl,
+	Assign,
+	If,
+	Block,
+	While
 };
 
-/* --------------------------------------------------------------------------------------------- */
+// Nodes live in a CompilationUnit's arena and are never destroyed one by one, so they have to be
+// trivially destructible: children are plain pointers into the same arena and the destructor is
+// neither virtual nor public (nothing may delete a node through a base pointer)
 
 // default expression type
 struct Expr {
 	Location m_loc{};
-	virtual ~Expr() = default;	 // DESTRUCTOR
+	const NodeKind kind;	 // which of the structs below this really is
+	// what it evaluates to: T_int, T_string or T_bool. the semantic analyser works this out for
+	// every expression anyway and leaves it here, so later passes don't have to ask again.
+	// T_EOF until the analyser has been over it
+	TokenType m_type = TokenType::T_EOF;
 	// HELPER FOR PRINTING AST STRUCTURE
 	virtual void print( int indent = 0 ) const = 0;
+
+ protected:
+	explicit Expr( const NodeKind k ) : kind( k ) {}
+	~Expr() = default;	// DESTRUCTOR (trivial, the arena just drops the memory)
 };
 
 struct NumberExpr : Expr {
-	std::string value;
-	explicit NumberExpr( std::string val, const Location l ) : value( std::move( val ) )
+	int64_t value;	 // converted once by the parser, negative literals already folded in
+	explicit NumberExpr( const int64_t val, const Location l )
+		 : Expr( NodeKind::Number ), value( val )
 	{
 		m_loc = l;
 	}
@@ -42,8 +80,9 @@ struct NumberExpr : Expr {
 };
 
 struct StringExpr : Expr {
-	std::string value;
-	explicit StringExpr( std::string val, const Location l ) : value( std::move( val ) )
+	std::string_view value;	// view into the source text
+	explicit StringExpr( const std::string_view val, const Location l )
+		 : Expr( NodeKind::String ), value( val )
 	{
 		m_loc = l;
 	}
@@ -57,7 +96,7 @@ struct StringExpr : Expr {
 
 struct BoolExpr : Expr {
 	bool value;
-	BoolExpr( bool val, const Location l ) : value( val )
+	BoolExpr( bool val, const Location l ) : Expr( NodeKind::Bool ), value( val )
 	{
 		m_loc = l;
 	}
@@ -70,8 +109,11 @@ struct BoolExpr : Expr {
 };
 
 struct IdentExpr : Expr {
-	std::string name;
-	explicit IdentExpr( std::string nm, const Location l ) : name( std::move( nm ) )
+	std::string_view name;	// view into the source text
+	SymbolId symbol;			// the interned name, what every pass actually compares
+	Slot slot = NoSlot;		// which variable this is, filled in by the semantic analyser
+	IdentExpr( const std::string_view nm, const SymbolId sym, const Location l )
+		 : Expr( NodeKind::Ident ), name( nm ), symbol( sym )
 	{
 		m_loc = l;
 	}
@@ -85,13 +127,12 @@ struct IdentExpr : Expr {
 
 // == != >= <= etc
 struct BinaryExpr : Expr {
-	std::unique_ptr<Expr> left;
-	std::unique_ptr<Expr> right;
+	Expr* left;
+	Expr* right;
 	TokenType operatr;
 
-	BinaryExpr( std::unique_ptr<Expr> lf, const TokenType op, std::unique_ptr<Expr> rt,
-					const Location l )
-		 : left( std::move( lf ) ), right( std::move( rt ) ), operatr( op )
+	BinaryExpr( Expr* lf, const TokenType op, Expr* rt, const Location l )
+		 : Expr( NodeKind::Binary ), left( lf ), right( rt ), operatr( op )
 	{
 		m_loc = l;
 	}
@@ -110,18 +151,34 @@ struct BinaryExpr : Expr {
 
 struct Stmt {
 	Location m_loc{};
-	virtual ~Stmt() = default;
+	const NodeKind kind;
 	virtual void print( int indent = 0 ) const = 0;
+
+ protected:
+	explicit Stmt( const NodeKind k ) : kind( k ) {}
+	~Stmt() = default;
 };
 
+// the downcast after a switch on `kind` has picked the case: static, so it costs nothing
+// (const in, const out: only the resolver, which fills in slots, gets writable nodes)
+template <typename T, typename Node>
+auto& as( Node* node )
+{
+	using Out = std::conditional_t<std::is_const_v<Node>, const T, T>;
+	return *static_cast<Out*>( node );
+}
+
 // for variable declaration
 struct VarDeclStmt : Stmt {
 	TokenType type;
-	std::string name;
-	std::unique_ptr<Expr> expr;
-
-	VarDeclStmt( const TokenType tp, std::string nm, std::unique_ptr<Expr> i, const Location l )
-		 : type( tp ), name( std::move( nm ) ), expr( std::move( i ) )
+	std::string_view name;
+	SymbolId symbol;
+	Slot slot = NoSlot;	// the new variable's slot (semantic analyser)
+	Expr* expr;
+
+	VarDeclStmt( const TokenType tp, const std::string_view nm, const SymbolId sym, Expr* i,
+					 const Location l )
+		 : Stmt( NodeKind::VarDecl ), type( tp ), name( nm ), symbol( sym ), expr( i )
 	{
 		m_loc = l;
 	}
@@ -144,10 +201,12 @@ struct VarDeclStmt : Stmt {
 };
 
 struct AssignStmt : Stmt {
-	std::string name;
-	std::unique_ptr<Expr> value;
-	AssignStmt( std::string nm, std::unique_ptr<Expr> val, const Location l )
-		 : name( std::move( nm ) ), value( std::move( val ) )
+	std::string_view name;
+	SymbolId symbol;
+	Slot slot = NoSlot;	// the variable being assigned (semantic analyser)
+	Expr* value;
+	AssignStmt( const std::string_view nm, const SymbolId sym, Expr* val, const Location l )
+		 : Stmt( NodeKind::Assign ), name( nm ), symbol( sym ), value( val )
 	{
 		m_loc = l;
 	}
@@ -167,14 +226,12 @@ struct AssignStmt : Stmt {
 };
 
 struct IfStmt : Stmt {
-	std::unique_ptr<Expr> condition;
-	std::unique_ptr<Stmt> thenBranch;
-	std::unique_ptr<Stmt> elseBranch;
-
-	IfStmt( std::unique_ptr<Expr> cond, std::unique_ptr<Stmt> thenBr, const Location l,
-			  std::unique_ptr<Stmt> elseBr = nullptr )
-		 : condition( std::move( cond ) ), thenBranch( std::move( thenBr ) ),
-			elseBranch( std::move( elseBr ) )
+	Expr* condition;
+	Stmt* thenBranch;
+	Stmt* elseBranch;	// null when there is no else
+
+	IfStmt( Expr* cond, Stmt* thenBr, const Location l, Stmt* elseBr = nullptr )
+		 : Stmt( NodeKind::If ), condition( cond ), thenBranch( thenBr ), elseBranch( elseBr )
 	{
 		m_loc = l;
 	}
@@ -201,25 +258,26 @@ struct IfStmt : Stmt {
 };
 
 struct BlockStmt : Stmt {
-	std::vector<std::unique_ptr<Stmt>> statements;
+	std::span<Stmt*> statements;	// an array in the arena too
+
+	BlockStmt() : Stmt( NodeKind::Block ) {}
 
 	void print( const int indentLevel ) const override
 	{
 		indent( indentLevel );
 		std::cout << "BlockStmt" << '\n';
-		for ( auto& st : statements ) {
+		for ( const Stmt* st : statements ) {
 			st->print( indentLevel + 1 );
 		}
 	}
 };
 
 struct WhileStmt : Stmt {
-	std::unique_ptr<Expr> condition;
-	std::unique_ptr<Stmt> loopBody;
-
-	WhileStmt( std::unique_ptr<Expr> cond, std::unique_ptr<Stmt> lpBody, const Location l )
-		 : condition( std::move( cond ) ), loopBody( std::move( lpBody ) )
+	Expr* condition;
+	Stmt* loopBody;
 
+	WhileStmt( Expr* cond, Stmt* lpBody, const Location l )
+		 : Stmt( NodeKind::While ), condition( cond ), loopBody( lpBody )
 	{
 		m_loc = l;
 	}
@@ -241,37 +299,166 @@ struct WhileStmt : Stmt {
 
 /* --------------------------------------------------------------------------------------------- */
 
-class Parser {
+// The parser doesn't build nodes itself, it hands every piece to a Builder. That way the same
+// grammar code produces either this pointer tree (TreeBuilder) or the flat, index-based AST in
+// flatAst.hpp (FlatBuilder). A Builder provides:
+//   Output             what it builds into
+//   ExprRef / StmtRef  how it refers to a node it made, NoStmt for "no statement"
+//   one function per node kind, loc( ExprRef ), and addTopLevel( StmtRef )
+
+// builds the tree above in a CompilationUnit's arena
+struct TreeBuilder {
+	using Output = CompilationUnit;
+	using ExprRef = Expr*;
+	using StmtRef = Stmt*;
+	static constexpr Stmt* NoStmt = nullptr;
+
+	CompilationUnit& unit;
+
+	template <typename T, typename... Args>
+	T* make( Args&&... args )
+	{
+		return unit.arena.make<T>( std::forward<Args>( args )... );
+	}
+
+	Expr* number( const int64_t value, const Location l )
+	{
+		return make<NumberExpr>( value, l );
+	}
+	Expr* string( const std::string_view text, const Location l )
+	{
+		return make<StringExpr>( text, l );
+	}
+	Expr* boolean( const bool value, const Location l )
+	{
+		return make<BoolExpr>( value, l );
+	}
+	Expr* ident( const std::string_view name, const SymbolId sym, const Location l )
+	{
+		return make<IdentExpr>( name, sym, l );
+	}
+	Expr* binary( Expr* left, const TokenType op, Expr* right, const Location l )
+	{
+		return make<BinaryExpr>( left, op, right, l );
+	}
+
+	Stmt* varDecl( const TokenType type, const std::string_view name, const SymbolId sym, Expr* init,
+						const Location l )
+	{
+		return make<VarDeclStmt>( type, name, sym, init, l );
+	}
+	Stmt* assign( const std::string_view name, const SymbolId sym, Expr* value, const Location l )
+	{
+		return make<AssignStmt>( name, sym, value, l );
+	}
+	Stmt* ifStmt( Expr* cond, Stmt* thenBranch, Stmt* elseBranch, const Location l )
+	{
+		return make<IfStmt>( cond, thenBranch, l, elseBranch );
+	}
+	Stmt* whileStmt( Expr* cond, Stmt* body, const Location l )
+	{
+		return make<WhileStmt>( cond, body, l );
+	}
+	Stmt* block( std::span<Stmt* const> statements, Location l );
+
+	static Location loc( const Expr* expr )
+	{
+		return expr->m_loc;
+	}
+	void addTopLevel( Stmt* stmt )
+	{
+		unit.program.push_back( stmt );
+	}
+};
+
+/* --------------------------------------------------------------------------------------------- */
+
+template <typename Builder>
+class BasicParser {
  public:
-	explicit Parser( const std::vector<Token>& tokens );
-	std::vector<std::unique_ptr<Stmt>> parse();
+	using ExprRef = typename Builder::ExprRef;
+	using StmtRef = typename Builder::StmtRef;
+
+	// every node goes through the builder into `out`; parse() adds the top-level statements
+	BasicParser( const std::vector<Token>& tokens, typename Builder::Output& out );	// lexed buffer
+	BasicParser( Tokeniser& tokeniser, typename Builder::Output& out );	// pull tokens on demand
+	void parse();
+
+	// how deep statements and expressions may nest before parse() gives up with an error.
+	// every pass after the parser (analyser, interpreter, print) recurses over the tree, so this
+	// limit keeps all of them well inside the C++ stack. setMaxDepth() can raise it, but never
+	// past MaxDepthLimit: together with MaxExpressionHeight that is what fits in an 8 MB stack
+	static constexpr size_t DefaultMaxDepth = 1000;
+	static constexpr size_t MaxDepthLimit = 10000;
+	void setMaxDepth( size_t levels );
+
+	// a chain like 1 + 2 + 3 isn't nesting, but it leans left: one node per operator, and the
+	// passes recurse down the chain all the same. an expression tree may be this tall
+	static constexpr size_t MaxExpressionHeight = 10000;
 
 	//  private:
 
 	// parsing
-	std::unique_ptr<Stmt> parseStatement();
-	std::unique_ptr<Stmt> parseBlock();
-	std::unique_ptr<Stmt> parseVarDecl();
-	std::unique_ptr<Stmt> parseAssignment();
-	std::unique_ptr<Stmt> parseIfStmt();
-	std::unique_ptr<Stmt> parseWhileStmt();
-
-	std::unique_ptr<Expr> parseExpression();
-	std::unique_ptr<Expr> parsePrimary();
-
-	std::unique_ptr<Expr> parseEquality();
-	std::unique_ptr<Expr> parseComparison();
-	std::unique_ptr<Expr> parseTerm();
-	std::unique_ptr<Expr> parseFactor();
-	std::unique_ptr<Expr> parseUnary();
+	StmtRef parseStatement();
+	StmtRef parseBlock();
+	StmtRef parseVarDecl();
+	StmtRef parseAssignment();
+	StmtRef parseIfStmt();
+	StmtRef parseWhileStmt();
+
+	ExprRef parseExpression();
+	ExprRef parseBinary( uint8_t minPower );	// every infix operator, by binding power
+	ExprRef parseUnary();
+	ExprRef parsePrimary();
 
  private:
-	const std::vector<Token>& m_tokens;
-	size_t m_pos = 0;
+	// token source: exactly one of these is set
+	const std::vector<Token>* m_tokens = nullptr;
+	Tokeniser* m_lexer = nullptr;
+	size_t m_pos = 0;	 // next buffered token to pull
+
+	Builder m_build;
+	// statements of the blocks being parsed, innermost last. a finished block hands its own run
+	// to the builder and truncates, so one buffer serves every block at every depth
+	std::vector<StmtRef> m_blockScratch;
+
+	// how deep we are right now: one level per statement inside a statement and per operand
+	// inside an operand (brackets, unary minus)
+	size_t m_depth = 0;
+	size_t m_maxDepth = DefaultMaxDepth;
+	// height of the expression tree parsed last, a leaf being 1. counted from the nodes actually
+	// built, so `((a + b) + c) + d` is as tall as `a + b + c + d`
+	size_t m_height = 0;
+	void setHeight( size_t height );	 // throws past MaxExpressionHeight
+
+	// remembers m_depth and puts it back when the parse function it lives in returns
+	class DepthScope {
+	 public:
+		explicit DepthScope( BasicParser& parser ) : m_parser( parser ), m_saved( parser.m_depth ) {}
+		~DepthScope() { m_parser.m_depth = m_saved; }
+		DepthScope( const DepthScope& ) = delete;
+		DepthScope& operator=( const DepthScope& ) = delete;
+
+		void nest();	// one level deeper, throws past the limit
+
+	 private:
+		BasicParser& m_parser;
+		size_t m_saved;
+	};
+
+	// the grammar needs one token of lookahead plus the one just consumed, so that is all we keep.
+	// in streaming mode this makes token memory constant no matter how big the input is
+	Token m_previous{};
+	Token m_current{};
 
 	// helpers
+	Token pull();
 	[[nodiscard]] const Token& peek() const;
+	[[nodiscard]] const Token& previous() const;
 	const Token& advance();
 	bool match( TokenType type );
 	const Token& expect( TokenType type, const char* msg );
 };
+
+// the usual parser: builds the pointer tree in a CompilationUnit
+using Parser = BasicParser<TreeBuilder>;
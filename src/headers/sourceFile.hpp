@@ -0,0 +1,42 @@
+// src\headers\sourceFile.hpp
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only view of one input file that lives for the whole compilation.
+// Regular files are memory-mapped, so no copy of the text is ever made; pipes and stdin fall back
+// to a single read into one owned buffer. Either way text() is contiguous and the byte right
+// after it is always '\0', so the tokeniser can use it as a sentinel.
+class SourceFile {
+ public:
+	SourceFile() = default;
+	~SourceFile();
+
+	// owns a mapping, so it can only be moved
+	SourceFile( const SourceFile& ) = delete;
+	SourceFile& operator=( const SourceFile& ) = delete;
+	SourceFile( SourceFile&& other ) noexcept;
+	SourceFile& operator=( SourceFile&& other ) noexcept;
+
+	// "-" reads stdin; throws std::runtime_error if the file can't be opened or read
+	static SourceFile load( const std::string& path );
+
+	[[nodiscard]] std::string_view text() const { return { m_data, m_size }; }
+	[[nodiscard]] bool isMapped() const { return m_mapBase != nullptr; }
+
+ private:
+	bool tryMap( const std::string& path );					// false if the file can't be mapped
+	static SourceFile readStream( std::FILE* stream );	// the fallback for anything else
+	void release();
+
+	const char* m_data = "";  // start of the text, never null
+	size_t m_size = 0;		  // text length, not counting the sentinel
+
+	void* m_mapBase = nullptr;				// start of the mapping (null when the text is owned)
+	size_t m_mapLength = 0;					// bytes reserved for the mapping
+	std::vector<char> m_owned;				// buffer used by the read fallback
+};
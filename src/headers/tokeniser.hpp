@@ -1,14 +1,19 @@
 // src\headers\tokeniser.hpp
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
+#include "interner.hpp"
+#include "location.hpp"
+
 // # Global Data
 
-// strongly typed list of tokentypes
-enum class TokenType	 // enum class is safer than enum & prvnts name collisions
+// strongly typed list of tokentypes (one byte each, so token and node arrays stay small)
+enum class TokenType : uint8_t	// enum class is safer than enum & prvnts name collisions
 {
 	// Keywords
 	T_int,
@@ -62,8 +67,15 @@ enum class TokenType	 // enum class is safer than enum & prvnts name collisions
 	T_EOF
 };
 
+// a reserved word and the token it becomes
+struct Keyword {
+	std::string_view text;
+	TokenType type = TokenType::T_identifier;
+};
+
 // this way we won't have to do manual comparisons
-static const std::unordered_map<std::string, TokenType> g_keywords = {
+// to add a keyword just (un)comment its line: the hash table below rebuilds and re-checks itself
+inline constexpr Keyword g_keywords[] = {
 	{ "int", TokenType::T_int },
 	// { "long", TokenType::T_long },
 	// { "char", TokenType::T_char },
@@ -81,17 +93,77 @@ static const std::unordered_map<std::string, TokenType> g_keywords = {
 	//{ "for", TokenType::T_for },
 };
 
-// where token appears
-struct Location {
-	size_t line;
-	size_t column;
-};	 // will be Used for error messages later
+// Perfect hash over g_keywords, built by the compiler.
+// The slot comes from the first two chars and the length, mixed with a seed; the first seed that
+// puts every keyword in its own slot wins. Looking a word up is then one hash and one string
+// compare: no allocation and no bucket chasing.
+struct KeywordTable {
+	static constexpr size_t Size = 32;	// power of two, comfortably more than the keyword count
+	uint32_t seed = 0;						// 0 = no perfect seed was found
+	std::array<Keyword, Size> slots{};
+};
+
+// only called with 2+ chars (no keyword is shorter)
+constexpr uint32_t keywordHash( const std::string_view text, const uint32_t seed )
+{
+	const auto first = static_cast<unsigned char>( text[ 0 ] );
+	const auto second = static_cast<unsigned char>( text[ 1 ] );
+	return ( ( first * seed ) ^ ( second * 31u + static_cast<uint32_t>( text.size() ) ) ) &
+			 ( KeywordTable::Size - 1 );
+}
+
+constexpr KeywordTable buildKeywordTable()
+{
+	for ( uint32_t seed = 1; seed < 4096; ++seed ) {
+		KeywordTable table{ seed, {} };
+		bool perfect = true;
+		for ( const Keyword& kw : g_keywords ) {
+			Keyword& slot = table.slots[ keywordHash( kw.text, seed ) ];
+			if ( !slot.text.empty() ) {
+				perfect = false;	 // collision, try the next seed
+				break;
+			}
+			slot = kw;
+		}
+		if ( perfect ) {
+			return table;
+		}
+	}
+	return {};
+}
+
+inline constexpr KeywordTable g_keywordTable = buildKeywordTable();
+
+// returns the keyword's token type, or T_identifier for anything else
+constexpr TokenType keywordType( const std::string_view text )
+{
+	if ( text.size() < 2 ) {
+		return TokenType::T_identifier;
+	}
+	const Keyword& slot = g_keywordTable.slots[ keywordHash( text, g_keywordTable.seed ) ];
+	return slot.text == text ? slot.type : TokenType::T_identifier;	// empty slots never match
+}
+
+// every keyword must come back as itself, checked while compiling
+constexpr bool keywordTableIsPerfect()
+{
+	for ( const Keyword& kw : g_keywords ) {
+		if ( keywordType( kw.text ) != kw.type ) {
+			return false;
+		}
+	}
+	return g_keywordTable.seed != 0;
+}
+static_assert( keywordTableIsPerfect(), "g_keywords has no perfect hash: grow KeywordTable::Size" );
+static_assert( keywordType( "whilst" ) == TokenType::T_identifier );
+static_assert( keywordType( "x" ) == TokenType::T_identifier );
 
 // What a full token is
 struct Token {
-	TokenType type;	  // TokenType = what type is
-	std::string value;  // value = what text it came from
-	Location loc;		  // Location = where it is
+	TokenType type;			// TokenType = what type is
+	SymbolId symbol;			// identifiers only: the interned name (NoSymbol for everything else)
+	std::string_view value;	// value = what text it came from (a view into the source)
+	Location loc;				// Location = where it is (a byte offset, see location.hpp)
 };
 
 // # End of Global data
@@ -99,22 +171,51 @@ struct Token {
 class Tokeniser {
 
  public:
-	// constructor: takes entire file in string form
-	explicit Tokeniser( std::string source );	 // e.. prvnts accidental convrs
-
+	// constructor: takes a view of the entire file
+	// the caller owns the text and must keep it alive as long as the tokens (and AST) are used,
+	// since every Token::value points straight into it.
+	// every identifier is interned into `interner` as it is lexed.
+	// throws if the text is too big for a 32-bit Location
+	Tokeniser( std::string_view source, Interner& interner );
+
+	// lexes the whole input at once (always ends with T_EOF)
 	std::vector<Token> tokenise();
+	// streaming mode: lexes and returns just the next token, T_EOF forever after the end
+	Token next();
+
+	// inputs smaller than this stay serial, splitting them costs more than it saves
+	static constexpr size_t DefaultParallelMinBytes = 4 * 1024 * 1024;
+	// parallel mode for tokenise(): inputs of at least `minBytes` are split at new lines and lexed
+	// on `threads` threads (0 = one per core, 1 = serial). tokens, locations and errors are
+	// exactly the same as the serial path gives
+	void setParallel( unsigned threads, size_t minBytes = DefaultParallelMinBytes );
 
  private:
+	// one slice of a parallel run: lexes [begin, end) of `source`, so offsets stay file-wide
+	Tokeniser( std::string_view source, size_t begin, size_t end );
+
+	std::vector<Token> tokeniseParallel();
+	void skipOpenComment();	 // the slice starts inside a /* */ that began in an earlier slice
+
 	// private helper funcs
 	[[nodiscard]] char peek() const;	 // looks at current char
 	char advance();						 // consumes current char(moves forward)
-	void addToken( TokenType tType, std::string value = "", size_t startColumn = 1 );
-	// stores a token
+	void advanceTo( const char* stop );	 // consumes a whole run (whitespace, comment, name...)
+	[[nodiscard]] const char* cursor() const { return m_source.data() + m_index; }
+	[[nodiscard]] const char* sourceEnd() const { return m_source.data() + m_source.size(); }
+	Token lexOperator();	 // symbols, single or doubled
+	[[nodiscard]] Token makeToken( TokenType tType, std::string_view value, size_t startIndex ) const;
+	// builds a token that starts at byte startIndex
 
 	// member vars
-	std::string m_source;			// entire input file
+	std::string_view m_source;		// entire input file (not owned)
 	size_t m_index = 0;				// current position in the string
-	size_t m_line = 1;				// current line number
-	size_t m_column = 1;				// current column number
-	std::vector<Token> m_tokens;	// output tokens
+	// no line/column here: a token only records m_index, lines are counted if an error needs them
+	Interner* m_interner = nullptr;	// null while lexing a slice, the join interns those in order
+
+	// parallel mode
+	unsigned m_threads = 1;
+	size_t m_parallelMinBytes = DefaultParallelMinBytes;
+	bool m_isSlice = false;			// lexing one slice: a /* */ may run off the end of it
+	bool m_endsInComment = false;	// the slice ended inside that comment
 };
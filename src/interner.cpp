@@ -0,0 +1,12 @@
+// src\interner.cpp
+#include "headers/interner.hpp"
+
+SymbolId Interner::intern( const std::string_view name )
+{
+	// try_emplace only inserts when the name is new, so this is a single hash lookup either way
+	const auto [ slot, isNew ] = m_ids.try_emplace( name, static_cast<SymbolId>( m_names.size() ) );
+	if ( isNew ) {
+		m_names.push_back( name );
+	}
+	return slot->second;
+}
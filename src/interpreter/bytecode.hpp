@@ -0,0 +1,62 @@
+// src/interpreter/bytecode.hpp
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Register-based bytecode: what the BytecodeCompiler turns a checked AST into and the
+// VirtualMachine runs.
+// Every instruction names its registers directly (`a = b + c`), so there is no operand stack
+// to push to and pop from. The registers are one flat array of int64_t:
+//   0 .. frameSize-1    the program's variables, register n is slot n (see Slot in parser.hpp)
+//   frameSize ..        temporaries for the parts of an expression
+// An int is itself and a bool is 0 or 1. A string is a Value (value.hpp) in a second array
+// alongside: string register n is that array's entry n. The string ops below read and write
+// that array, the others the int one; the compiler picks them by the static types, so the VM
+// never has to look at what a register holds.
+
+enum class Op : uint8_t
+{
+	// # loads
+	LoadInt,	 // a = ints[ b ]
+	LoadStr,	 // a = strings[ b ] (a string register, see above)
+	Move,		 // a = b
+	MoveStr,	 // a = b, string registers
+	// # int arithmetic, wraps on overflow
+	Add,	// a = b + c
+	Sub,	// a = b - c
+	Mul,	// a = b * c
+	Div,	// a = b / c, "Division by zero" error when c is 0
+	// # comparisons, a = 1 or 0
+	Less,			 // ints
+	LessEq,		 // ints
+	Greater,		 // ints
+	GreaterEq,	 // ints
+	Equal,		 // ints or bools
+	NotEqual,	 // ints or bools
+	StrEqual,	 // strings
+	StrNotEqual,	// strings
+	// # strings
+	Concat,	// a = b + c, string registers
+	// # control flow, targets are instruction indexes
+	Jump,				 // go to a
+	JumpIfFalse,	 // go to b if a is 0
+	JumpIfTrue,		 // go to b if a isn't 0
+	Halt				 // the end of the program
+};
+
+// 16 bytes: the opcode and three operands, whatever the op uses (the rest are 0)
+struct Instr {
+	Op op;
+	uint32_t a = 0;
+	uint32_t b = 0;
+	uint32_t c = 0;
+};
+
+struct Bytecode {
+	std::vector<Instr> code;
+	std::vector<int64_t> ints;			  // the constant pool: every distinct int literal once
+	std::vector<std::string> strings;  // every distinct string literal once
+	uint32_t registerCount = 0;		  // variables and temporaries together
+};
@@ -0,0 +1,300 @@
+// src/interpreter/compiler.cpp
+#include "compiler.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include "../headers/tokeniser.hpp"
+
+/* --------------------------------------------------------------------------------------------- */
+// # Shared by both walks
+
+void BytecodeCompiler::begin( const Slot frameSize )
+{
+	m_out = Bytecode{};
+	m_intIndex.clear();
+	m_stringIndex.clear();
+	m_firstTemp = m_nextTemp = frameSize;
+	m_out.registerCount = frameSize;
+}
+
+Bytecode BytecodeCompiler::finish()
+{
+	emit( Op::Halt );
+	return std::move( m_out );
+}
+
+uint32_t BytecodeCompiler::temp()
+{
+	const uint32_t reg = m_nextTemp++;
+	m_out.registerCount = std::max( m_out.registerCount, m_nextTemp );
+	return reg;
+}
+
+uint32_t BytecodeCompiler::intConstant( const int64_t value )
+{
+	const auto [ it, added ] =
+		 m_intIndex.try_emplace( value, static_cast<uint32_t>( m_out.ints.size() ) );
+	if ( added ) {
+		m_out.ints.push_back( value );
+	}
+	return it->second;
+}
+
+uint32_t BytecodeCompiler::stringConstant( const std::string_view text )
+{
+	// the views point into the source, which outlives the compile
+	const auto [ it, added ] =
+		 m_stringIndex.try_emplace( text, static_cast<uint32_t>( m_out.strings.size() ) );
+	if ( added ) {
+		m_out.strings.emplace_back( text );
+	}
+	return it->second;
+}
+
+uint32_t BytecodeCompiler::emit( const Op op, const uint32_t a, const uint32_t b, const uint32_t c )
+{
+	m_out.code.push_back( Instr{ op, a, b, c } );
+	return here() - 1;
+}
+
+void BytecodeCompiler::patch( const uint32_t jump, const uint32_t target )
+{
+	Instr& instr = m_out.code[ jump ];
+	( instr.op == Op::Jump ? instr.a : instr.b ) = target;
+}
+
+Op BytecodeCompiler::binaryOpcode( const TokenType op, const TokenType leftType )
+{
+	switch ( op ) {
+	case TokenType::T_plus:
+		return leftType == TokenType::T_string ? Op::Concat : Op::Add;
+	case TokenType::T_minus:
+		return Op::Sub;
+	case TokenType::T_star:
+		return Op::Mul;
+	case TokenType::T_slash:
+		return Op::Div;
+	case TokenType::T_LeT:
+		return Op::Less;
+	case TokenType::T_LeTEq:
+		return Op::LessEq;
+	case TokenType::T_GrT:
+		return Op::Greater;
+	case TokenType::T_GrTEq:
+		return Op::GreaterEq;
+	case TokenType::T_eqEq:
+		return leftType == TokenType::T_string ? Op::StrEqual : Op::Equal;
+	case TokenType::T_NotE:
+		return leftType == TokenType::T_string ? Op::StrNotEqual : Op::NotEqual;
+	default:
+		throw std::runtime_error( "Unknown Binary Operator" );
+	}
+}
+
+/* --------------------------------------------------------------------------------------------- */
+// # The pointer tree
+
+Bytecode BytecodeCompiler::compile( const std::vector<Stmt*>& program, const Slot frameSize )
+{
+	begin( frameSize );
+	for ( const Stmt* stmt : program ) {
+		compileStmt( stmt );
+	}
+	return finish();
+}
+
+uint32_t BytecodeCompiler::compileExpr( const Expr* expr, const uint32_t dest )
+{
+	switch ( expr->kind ) {
+	case NodeKind::Number: {
+		const uint32_t reg = dest != NoRegister ? dest : temp();
+		emit( Op::LoadInt, reg, intConstant( as<NumberExpr>( expr ).value ) );
+		return reg;
+	}
+	case NodeKind::Bool: {
+		const uint32_t reg = dest != NoRegister ? dest : temp();
+		emit( Op::LoadInt, reg, intConstant( as<BoolExpr>( expr ).value ? 1 : 0 ) );
+		return reg;
+	}
+	case NodeKind::String: {
+		const uint32_t reg = dest != NoRegister ? dest : temp();
+		emit( Op::LoadStr, reg, stringConstant( as<StringExpr>( expr ).value ) );
+		return reg;
+	}
+	case NodeKind::Ident: {
+		// the variable already is a register: only copy it if it has to be somewhere else
+		const Slot slot = as<IdentExpr>( expr ).slot;
+		if ( dest == NoRegister || dest == slot ) {
+			return slot;
+		}
+		emit( expr->m_type == TokenType::T_string ? Op::MoveStr : Op::Move, dest, slot );
+		return dest;
+	}
+	case NodeKind::Binary: {
+		// both operands are worked out before `dest` is written, so `x = x + 1` can use x's
+		// register straight away
+		const auto& bin = as<BinaryExpr>( expr );
+		const uint32_t left = compileExpr( bin.left );
+		const uint32_t right = compileExpr( bin.right );
+		const uint32_t reg = dest != NoRegister ? dest : temp();
+		emit( binaryOpcode( bin.operatr, bin.left->m_type ), reg, left, right );
+		return reg;
+	}
+	default:
+		throw std::runtime_error( "Unknown expression type" );
+	}
+}
+
+void BytecodeCompiler::compileStmt( const Stmt* stmt )
+{
+	m_nextTemp = m_firstTemp;	// the last statement's temporaries are free again
+	switch ( stmt->kind ) {
+	case NodeKind::VarDecl: {
+		const auto& var = as<VarDeclStmt>( stmt );
+		compileExpr( var.expr, var.slot );
+		return;
+	}
+	case NodeKind::Assign: {
+		const auto& assign = as<AssignStmt>( stmt );
+		compileExpr( assign.value, assign.slot );
+		return;
+	}
+	case NodeKind::Block:
+		for ( const Stmt* st : as<BlockStmt>( stmt ).statements ) {
+			compileStmt( st );
+		}
+		return;
+	case NodeKind::If: {
+		/*	   cond -> r
+				JumpIfFalse r, ELSE
+				then branch
+				Jump END			 (only with an else)
+			ELSE:
+				else branch
+			END:
+		*/
+		const auto& ifs = as<IfStmt>( stmt );
+		const uint32_t toElse = emit( Op::JumpIfFalse, compileExpr( ifs.condition ) );
+		compileStmt( ifs.thenBranch );
+		if ( ifs.elseBranch ) {
+			const uint32_t toEnd = emit( Op::Jump );
+			patch( toElse, here() );
+			compileStmt( ifs.elseBranch );
+			patch( toEnd, here() );
+		} else {
+			patch( toElse, here() );
+		}
+		return;
+	}
+	case NodeKind::While: {
+		/*	   Jump COND
+			BODY:
+				body
+			COND:
+				cond -> r
+				JumpIfTrue r, BODY
+			the condition sits at the bottom, so a trip round the loop is one jump, not two
+		*/
+		const auto& w = as<WhileStmt>( stmt );
+		const uint32_t toCond = emit( Op::Jump );
+		const uint32_t body = here();
+		compileStmt( w.loopBody );
+		patch( toCond, here() );
+		m_nextTemp = m_firstTemp;
+		emit( Op::JumpIfTrue, compileExpr( w.condition ), body );
+		return;
+	}
+	default:
+		throw std::runtime_error( "Unknown Statement type" );
+	}
+}
+
+/* --------------------------------------------------------------------------------------------- */
+// # The flat AST: the same code from the same program
+
+Bytecode BytecodeCompiler::compile( const FlatAst& ast, const Slot frameSize )
+{
+	begin( frameSize );
+	for ( const NodeIndex stmt : ast.program ) {
+		compileStmt( ast, stmt );
+	}
+	return finish();
+}
+
+uint32_t BytecodeCompiler::compileExpr( const FlatAst& ast, const NodeIndex node,
+													 const uint32_t dest )
+{
+	switch ( ast.kinds[ node ] ) {
+	case NodeKind::Number: {
+		const uint32_t reg = dest != NoRegister ? dest : temp();
+		emit( Op::LoadInt, reg, intConstant( ast.numbers[ ast.a[ node ] ] ) );
+		return reg;
+	}
+	case NodeKind::Bool: {
+		const uint32_t reg = dest != NoRegister ? dest : temp();
+		emit( Op::LoadInt, reg, intConstant( ast.a[ node ] ) );
+		return reg;
+	}
+	case NodeKind::String: {
+		const uint32_t reg = dest != NoRegister ? dest : temp();
+		emit( Op::LoadStr, reg, stringConstant( ast.literals[ ast.a[ node ] ] ) );
+		return reg;
+	}
+	case NodeKind::Ident: {
+		const Slot slot = ast.c[ node ];
+		if ( dest == NoRegister || dest == slot ) {
+			return slot;
+		}
+		emit( ast.types[ node ] == TokenType::T_string ? Op::MoveStr : Op::Move, dest, slot );
+		return dest;
+	}
+	case NodeKind::Binary: {
+		const uint32_t left = compileExpr( ast, ast.a[ node ] );
+		const uint32_t right = compileExpr( ast, ast.b[ node ] );
+		const uint32_t reg = dest != NoRegister ? dest : temp();
+		emit( binaryOpcode( ast.tags[ node ], ast.types[ ast.a[ node ] ] ), reg, left, right );
+		return reg;
+	}
+	default:
+		throw std::runtime_error( "Unknown expression type" );
+	}
+}
+
+void BytecodeCompiler::compileStmt( const FlatAst& ast, const NodeIndex node )
+{
+	m_nextTemp = m_firstTemp;
+	switch ( ast.kinds[ node ] ) {
+	case NodeKind::VarDecl:
+	case NodeKind::Assign:
+		compileExpr( ast, ast.b[ node ], ast.c[ node ] );
+		return;
+	case NodeKind::Block:
+		for ( const NodeIndex st : ast.blockStatements( node ) ) {
+			compileStmt( ast, st );
+		}
+		return;
+	case NodeKind::If: {
+		const uint32_t toElse = emit( Op::JumpIfFalse, compileExpr( ast, ast.a[ node ] ) );
+		compileStmt( ast, ast.b[ node ] );
+		if ( ast.c[ node ] != NoNode ) {
+			const uint32_t toEnd = emit( Op::Jump );
+			patch( toElse, here() );
+			compileStmt( ast, ast.c[ node ] );
+			patch( toEnd, here() );
+		} else {
+			patch( toElse, here() );
+		}
+		return;
+	}
+	case NodeKind::While: {
+		const uint32_t toCond = emit( Op::Jump );
+		const uint32_t body = here();
+		compileStmt( ast, ast.b[ node ] );
+		patch( toCond, here() );
+		m_nextTemp = m_firstTemp;
+		emit( Op::JumpIfTrue, compileExpr( ast, ast.a[ node ] ), body );
+		return;
+	}
+	default:
+		throw std::runtime_error( "Unknown Statement type" );
+	}
+}
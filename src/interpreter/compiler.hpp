@@ -0,0 +1,53 @@
+// src/interpreter/compiler.hpp
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../headers/flatAst.hpp"
+#include "../headers/parser.hpp"
+#include "bytecode.hpp"
+
+// Turns a program the semantic analyser has checked into Bytecode (see bytecode.hpp).
+// It leans on what the analyser wrote onto the AST: a variable is its slot, so a read needs no
+// instruction at all (the slot's register is the operand), and each expression's static type
+// picks the typed op (== on strings is StrEqual, on ints Equal; + on strings is Concat).
+// `frameSize` is how many slots the program uses (SemanticAnalyser::frameSize(), or
+// FlatAst::frameSize()): the temporaries go after them.
+class BytecodeCompiler {
+ public:
+	Bytecode compile( const std::vector<Stmt*>& program, Slot frameSize );
+	Bytecode compile( const FlatAst& ast, Slot frameSize );	// the same, from the flat AST
+
+ private:
+	static constexpr uint32_t NoRegister = UINT32_MAX;
+
+	Bytecode m_out;
+	uint32_t m_firstTemp = 0;	// temporaries start here
+	uint32_t m_nextTemp = 0;	// next free one. they only live within one statement
+	std::unordered_map<int64_t, uint32_t> m_intIndex;				  // int constant -> pool index
+	std::unordered_map<std::string_view, uint32_t> m_stringIndex;  // literal text -> index
+
+	void begin( Slot frameSize );
+	Bytecode finish();
+
+	uint32_t temp();
+	uint32_t intConstant( int64_t value );
+	uint32_t stringConstant( std::string_view text );
+	uint32_t emit( Op op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0 );	 // returns its index
+	[[nodiscard]] uint32_t here() const { return static_cast<uint32_t>( m_out.code.size() ); }
+	void patch( uint32_t jump, uint32_t target );	// fills in a jump once its target is known
+
+	// the op for `left op right`, `leftType` being the operands' static type
+	static Op binaryOpcode( TokenType op, TokenType leftType );
+
+	// the expression's value ends up in `dest` if one is given, else wherever is cheapest
+	// (a variable's own register, or a new temporary). returns the register it is in
+	void compileStmt( const Stmt* stmt );
+	uint32_t compileExpr( const Expr* expr, uint32_t dest = NoRegister );
+
+	void compileStmt( const FlatAst& ast, NodeIndex node );
+	uint32_t compileExpr( const FlatAst& ast, NodeIndex node, uint32_t dest = NoRegister );
+};
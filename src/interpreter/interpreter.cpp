@@ -1,64 +1,252 @@
 // src/interpreter/interpreter.cpp
 #include "interpreter.hpp"
+#include <stdexcept>
 #include "../headers/SemanticAnalyser.hpp"
 #include "../headers/parser.hpp"
 #include "../headers/tokeniser.hpp"
 
+namespace
+{
+
+// ints wrap around on overflow like they do in the hardware (signed overflow is undefined in
+// C++, so the arithmetic is done unsigned and converted back)
+int64_t wrap( const uint64_t value )
+{
+	return static_cast<int64_t>( value );
+}
+
+// true/false are plain ints at runtime: 1 and 0
+int64_t truth( const bool value )
+{
+	return value ? 1 : 0;
+}
+
+}	// namespace
+
+// what `left op right` gives on two ints (bools are ints too), shared by the tree and the flat
+// walk. the semantic analyser has already made sure the operand types fit the operator
+int64_t Interpreter::binaryOp( const TokenType op, const int64_t l, const int64_t r )
+{
+	const auto ul = static_cast<uint64_t>( l );
+	const auto ur = static_cast<uint64_t>( r );
+	switch ( op ) {
+	case TokenType::T_plus:
+		return wrap( ul + ur );
+	case TokenType::T_minus:
+		return wrap( ul - ur );
+	case TokenType::T_star:
+		return wrap( ul * ur );
+	case TokenType::T_slash:
+		if ( r == 0 ) {
+			throw std::runtime_error( "Division by zero" );
+		}
+		if ( r == -1 ) {
+			return wrap( 0 - ul );	// INT64_MIN / -1 wraps back to INT64_MIN instead of trapping
+		}
+		return l / r;
+	case TokenType::T_LeT:
+		return truth( l < r );
+	case TokenType::T_LeTEq:
+		return truth( l <= r );
+	case TokenType::T_GrT:
+		return truth( l > r );
+	case TokenType::T_GrTEq:
+		return truth( l >= r );
+	case TokenType::T_eqEq:
+		return truth( l == r );
+	case TokenType::T_NotE:
+		return truth( l != r );
+	default:
+		throw std::runtime_error( "Unknown Binary Operator" );
+	}
+}
+
+// == and != are the only operators that take strings
+int64_t Interpreter::compareStrings( const TokenType op, const Value& left, const Value& right )
+{
+	const bool same = left.asString() == right.asString();
+	return truth( op == TokenType::T_eqEq ? same : !same );
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+// every expression's static type was written onto it by the semantic analyser, so the walk
+// knows up front which values are ints: those never get wrapped in a Value on the way up
 Value Interpreter::evaluateExpr( const Expr* expr )
 {
-	if ( const auto num = dynamic_cast<const NumberExpr*>( expr ) ) {
-		return std::stoi( num->value );
+	if ( expr->m_type == TokenType::T_bool ) {
+		return Value::fromBool( evaluateInt( expr ) != 0 );
 	}
-	if ( const auto str = dynamic_cast<const StringExpr*>( expr ) ) {
-		return str->value;
+	if ( expr->m_type != TokenType::T_string ) {
+		return Value::fromInt( evaluateInt( expr ) );
 	}
-	if ( const auto ident = dynamic_cast<const IdentExpr*>( expr ) ) {
-		return env.variables.at( ident->name );
+	// a string is a literal, a variable or a +
+	switch ( expr->kind ) {
+	case NodeKind::String:
+		return Value::fromString( as<StringExpr>( expr ).value );  // points at the source, no copy
+	case NodeKind::Ident:
+		return env.get( as<IdentExpr>( expr ).slot );	// resolved by the analyser: just an index
+	case NodeKind::Binary:
+		return Value::concat( evaluateExpr( as<BinaryExpr>( expr ).left ),
+									 evaluateExpr( as<BinaryExpr>( expr ).right ) );
+	default:
+		throw std::runtime_error( "Unknown expression type" );
 	}
-	if ( const auto bin = dynamic_cast<const BinaryExpr*>( expr ) ) {
-		const Value left = evaluateExpr( bin->left.get() );
-		const Value right = evaluateExpr( bin->right.get() );
-		if ( bin->operatr == TokenType::T_plus ) {
-			return std::get<int>( left ) + std::get<int>( right );
-		}
-		if ( bin->operatr == TokenType::T_minus ) {
-			return std::get<int>( left ) - std::get<int>( right );
+}
+
+int64_t Interpreter::evaluateInt( const Expr* expr )
+{
+	// one jump on the node's kind, then a static downcast
+	switch ( expr->kind ) {
+	case NodeKind::Number:
+		return as<NumberExpr>( expr ).value;  // already a number, parsed once by the parser
+	case NodeKind::Bool:
+		return truth( as<BoolExpr>( expr ).value );
+	case NodeKind::Ident:
+		return env.get( as<IdentExpr>( expr ).slot ).asInt();
+	case NodeKind::Binary: {
+		const auto& bin = as<BinaryExpr>( expr );
+		if ( bin.left->m_type == TokenType::T_string ) {
+			return compareStrings( bin.operatr, evaluateExpr( bin.left ), evaluateExpr( bin.right ) );
 		}
+		return binaryOp( bin.operatr, evaluateInt( bin.left ), evaluateInt( bin.right ) );
+	}
+	default:
+		throw std::runtime_error( "Unknown expression type" );
 	}
-	throw std::runtime_error( "Unknown expression type" );
 }
 
 /* --------------------------------------------------------------------------------------------- */
 
 void Interpreter::executeStmt( const Stmt* stmt )
 {
-	if ( const auto var = dynamic_cast<const VarDeclStmt*>( stmt ) ) {
-		const Value val = evaluateExpr( var->expr.get() );
-		env.variables[ var->name ] = val;
-	}
-	if ( const auto assign = dynamic_cast<const AssignStmt*>( stmt ) ) {
-		const Value val = evaluateExpr( assign->value.get() );
-		env.variables[ assign->name ] = val;
-	}
-	if ( const auto ifs = dynamic_cast<const IfStmt*>( stmt ) ) {
-		const Value cond = evaluateExpr( ifs->condition.get() );
-		if ( std::get<int>( cond ) != 0 ) {
-			executeStmt( ifs->thenBranch.get() );
-		} else if ( ifs->elseBranch ) {
-			executeStmt( ifs->elseBranch.get() );
+	switch ( stmt->kind ) {
+	case NodeKind::VarDecl: {
+		const auto& var = as<VarDeclStmt>( stmt );
+		env.set( var.slot, evaluateExpr( var.expr ) );
+		return;
+	}
+	case NodeKind::Assign: {
+		const auto& assign = as<AssignStmt>( stmt );
+		env.set( assign.slot, evaluateExpr( assign.value ) );
+		return;
+	}
+	case NodeKind::Block:
+		for ( const Stmt* st : as<BlockStmt>( stmt ).statements ) {
+			executeStmt( st );
+		}
+		return;
+	case NodeKind::If: {
+		const auto& ifs = as<IfStmt>( stmt );
+		if ( evaluateInt( ifs.condition ) != 0 ) {
+			executeStmt( ifs.thenBranch );
+		} else if ( ifs.elseBranch ) {
+			executeStmt( ifs.elseBranch );
 		}
+		return;
 	}
-	if ( const auto w = dynamic_cast<const WhileStmt*>( stmt ) ) {
-		while ( std::get<int>( evaluateExpr( w->condition.get() ) ) != 0 ) {
-			executeStmt( w->loopBody.get() );
+	case NodeKind::While: {
+		const auto& w = as<WhileStmt>( stmt );
+		while ( evaluateInt( w.condition ) != 0 ) {
+			executeStmt( w.loopBody );
 		}
+		return;
+	}
+	default:
+		throw std::runtime_error( "Unknown Statement type" );
 	}
 }
 
 /* --------------------------------------------------------------------------------------------- */
-void Interpreter::execute( const std::vector<std::unique_ptr<Stmt>>& statements )
+void Interpreter::execute( const std::vector<Stmt*>& statements, const Slot frameSize )
+{
+	env.reset( frameSize );
+	for ( const Stmt* stmt : statements ) {
+		executeStmt( stmt );
+	}
+}
+
+
+/* --------------------------------------------------------------------------------------------- */
+// # The flat AST: same behaviour as the tree walk above, the kind comes from an array
+
+Value Interpreter::evaluateExpr( const FlatAst& ast, const NodeIndex node )
+{
+	if ( ast.types[ node ] == TokenType::T_bool ) {
+		return Value::fromBool( evaluateInt( ast, node ) != 0 );
+	}
+	if ( ast.types[ node ] != TokenType::T_string ) {
+		return Value::fromInt( evaluateInt( ast, node ) );
+	}
+	switch ( ast.kinds[ node ] ) {
+	case NodeKind::String:
+		return Value::fromString( ast.literals[ ast.a[ node ] ] );
+	case NodeKind::Ident:
+		return env.get( ast.c[ node ] );
+	case NodeKind::Binary:
+		return Value::concat( evaluateExpr( ast, ast.a[ node ] ),
+									 evaluateExpr( ast, ast.b[ node ] ) );
+	default:
+		throw std::runtime_error( "Unknown expression type" );
+	}
+}
+
+int64_t Interpreter::evaluateInt( const FlatAst& ast, const NodeIndex node )
+{
+	switch ( ast.kinds[ node ] ) {
+	case NodeKind::Number:
+		return ast.numbers[ ast.a[ node ] ];
+	case NodeKind::Bool:
+		return truth( ast.a[ node ] != 0 );
+	case NodeKind::Ident:
+		return env.get( ast.c[ node ] ).asInt();
+	case NodeKind::Binary: {
+		const NodeIndex left = ast.a[ node ];
+		const NodeIndex right = ast.b[ node ];
+		if ( ast.types[ left ] == TokenType::T_string ) {
+			return compareStrings( ast.tags[ node ], evaluateExpr( ast, left ),
+										  evaluateExpr( ast, right ) );
+		}
+		return binaryOp( ast.tags[ node ], evaluateInt( ast, left ), evaluateInt( ast, right ) );
+	}
+	default:
+		throw std::runtime_error( "Unknown expression type" );
+	}
+}
+
+void Interpreter::executeStmt( const FlatAst& ast, const NodeIndex node )
+{
+	switch ( ast.kinds[ node ] ) {
+	case NodeKind::VarDecl:
+	case NodeKind::Assign:
+		env.set( ast.c[ node ], evaluateExpr( ast, ast.b[ node ] ) );
+		return;
+	case NodeKind::Block:
+		for ( const NodeIndex st : ast.blockStatements( node ) ) {
+			executeStmt( ast, st );
+		}
+		return;
+	case NodeKind::If:
+		if ( evaluateInt( ast, ast.a[ node ] ) != 0 ) {
+			executeStmt( ast, ast.b[ node ] );
+		} else if ( ast.c[ node ] != NoNode ) {
+			executeStmt( ast, ast.c[ node ] );
+		}
+		return;
+	case NodeKind::While:
+		while ( evaluateInt( ast, ast.a[ node ] ) != 0 ) {
+			executeStmt( ast, ast.b[ node ] );
+		}
+		return;
+	default:
+		throw std::runtime_error( "Unknown Statement type" );
+	}
+}
+
+void Interpreter::execute( const FlatAst& ast, const Slot frameSize )
 {
-	for ( const auto& stmt : statements ) {
-		executeStmt( stmt.get() );
+	env.reset( frameSize );
+	for ( const NodeIndex stmt : ast.program ) {
+		executeStmt( ast, stmt );
 	}
 }
@@ -1,18 +1,41 @@
 // src/interpreter/interpreter.hpp
 #pragma once
 
-#include <memory>
 #include <vector>
 
+#include "../headers/flatAst.hpp"
 #include "../headers/parser.hpp"
+#include "value.hpp"
 
+// The tree walker: runs the AST as it is, node by node. The bytecode VM (vm.hpp) is the fast
+// way to run a program; this stays as the reference it is checked against (--verify-vm)
 class Interpreter {
  public:
-	void execute( const std::vector<std::unique_ptr<Stmt>>& statements );
+	// runs a program the semantic analyser has checked (and so resolved: variables are slots).
+	// `frameSize` is how many slots it uses (SemanticAnalyser::frameSize(), or
+	// FlatAst::frameSize()): they are all there, as the int 0, before the first statement runs
+	void execute( const std::vector<Stmt*>& statements, Slot frameSize );
+	void execute( const FlatAst& ast, Slot frameSize );	// the same, on the flat AST
+
+	// a variable after the run (a slot nothing was written to reads as 0)
+	[[nodiscard]] Value variable( const Slot slot ) const { return env.get( slot ); }
+
+	// every binary operator on ints, for both walks. the constant folder works expressions out
+	// with it too, so a folded one can't give anything else than running it would
+	static int64_t binaryOp( TokenType op, int64_t l, int64_t r );
 
  private:
 	Environment env;
 
 	void executeStmt( const Stmt* stmt );
 	Value evaluateExpr( const Expr* expr );
+	// for the expressions the analyser typed int or bool: no Value, no tag to look at
+	int64_t evaluateInt( const Expr* expr );
+
+	void executeStmt( const FlatAst& ast, NodeIndex node );
+	Value evaluateExpr( const FlatAst& ast, NodeIndex node );
+	int64_t evaluateInt( const FlatAst& ast, NodeIndex node );
+
+	// == and != on two strings
+	static int64_t compareStrings( TokenType op, const Value& left, const Value& right );
 };
@@ -0,0 +1,69 @@
+// src/interpreter/value.cpp
+#include "value.hpp"
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+
+/* --------------------------------------------------------------------------------------------- */
+// # Long strings: shared buffers
+
+Value Value::shared( StringBuffer* const buffer, const uint32_t length )
+{
+	Value v;
+	v.store( 0, buffer );
+	v.store( 8, length );
+	v.m_tag = Tag::Shared;
+	return v;	// the caller has already counted this reference
+}
+
+void Value::freeBuffer( StringBuffer* const buffer )
+{
+	buffer->~StringBuffer();
+	::operator delete( buffer );
+}
+
+/* --------------------------------------------------------------------------------------------- */
+// # +
+
+Value Value::concat( const Value& left, const Value& right )
+{
+	const std::string_view l = left.asString();
+	const std::string_view r = right.asString();
+	const size_t length = l.size() + r.size();
+
+	// short: no buffer at all, the text goes inside the value
+	if ( length <= InlineCapacity ) {
+		Value v;
+		std::copy( l.begin(), l.end(), v.m_bytes );
+		std::copy( r.begin(), r.end(), v.m_bytes + l.size() );
+		v.m_bytes[ InlineCapacity ] = static_cast<char>( length );
+		v.m_tag = Tag::Inline;
+		return v;
+	}
+	if ( length > UINT32_MAX / 2 ) {
+		throw std::runtime_error( "String too long" );
+	}
+
+	// left ends where its buffer's text ends and the rest fits: write right after it.
+	// the strings already looking at the buffer only see bytes before `used`, so none of them
+	// changes (and right may be in this very buffer: it is read from before `used` too)
+	if ( left.m_tag == Tag::Shared ) {
+		StringBuffer* const buffer = left.buffer();
+		if ( buffer->used == l.size() && length <= buffer->capacity ) {
+			std::copy( r.begin(), r.end(), buffer->text() + buffer->used );
+			buffer->used = static_cast<uint32_t>( length );
+			++buffer->refs;
+			return shared( buffer, buffer->used );
+		}
+	}
+
+	// else a new buffer, twice as long as this string: the next few + on it are appends.
+	// a loop building a string copies each byte a couple of times in all, not once a trip
+	const auto capacity = static_cast<uint32_t>( length * 2 );
+	auto* buffer = new ( ::operator new( sizeof( StringBuffer ) + capacity ) ) StringBuffer;
+	buffer->capacity = capacity;
+	std::copy( l.begin(), l.end(), buffer->text() );
+	std::copy( r.begin(), r.end(), buffer->text() + l.size() );
+	buffer->used = static_cast<uint32_t>( length );
+	return shared( buffer, buffer->used );
+}
@@ -0,0 +1,197 @@
+// src/interpreter/value.hpp
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "../headers/parser.hpp"
+
+// The text of a long string built at run time (by +). One allocation: this header, then
+// `capacity` bytes of text. Values share it and count themselves in `refs`; the last one to let
+// go frees it. Nothing in it is ever overwritten: a + only writes past `used`, so every string
+// looking at a prefix of the buffer stays exactly as it was (see Value::concat)
+struct StringBuffer {
+	uint32_t refs = 1;
+	uint32_t used = 0;	// bytes written so far
+	uint32_t capacity = 0;
+
+	char* text() { return reinterpret_cast<char*>( this + 1 ); }
+	const char* text() const { return reinterpret_cast<const char*>( this + 1 ); }
+};
+
+// What a Carp variable holds at run time: 16 bytes, the value and a tag.
+//   int     the number, right there
+//   bool    0 or 1, but tagged as a bool (so it prints as true/false and never equals an int)
+//   string  one of three, all the same to the language:
+//           - a literal: a pointer and a length into the program's own text (the source, or the
+//             VM's constant pool), which outlives the run. nothing to copy, nothing to free
+//           - a short one (up to InlineCapacity bytes): the text itself, inside the 16 bytes
+//           - a long one: a StringBuffer shared with every copy, and the length
+// Copying a Value never allocates. The worst it does is count one more owner of a buffer
+// (not atomically: a program runs on one thread).
+class Value {
+ public:
+	enum class Type : uint8_t
+	{
+		Int,
+		Bool,
+		String
+	};
+	static constexpr size_t InlineCapacity = 14;
+
+	Value() = default;	// the int 0, what a slot holds before it is written
+	Value( const Value& other ) noexcept { copyFrom( other ); }
+	Value( Value&& other ) noexcept
+	{
+		copyBytes( other );
+		other.m_tag = Tag::Int;	 // the buffer is ours now
+	}
+	Value& operator=( const Value& other ) noexcept
+	{
+		other.retain();  // first, in case other and this share the buffer
+		release();
+		copyBytes( other );
+		return *this;
+	}
+	Value& operator=( Value&& other ) noexcept
+	{
+		if ( this != &other ) {
+			release();
+			copyBytes( other );
+			other.m_tag = Tag::Int;
+		}
+		return *this;
+	}
+	~Value() { release(); }
+
+	static Value fromInt( const int64_t value )
+	{
+		Value v;
+		v.store( 0, value );
+		return v;
+	}
+	static Value fromBool( const bool value )
+	{
+		Value v = fromInt( value ? 1 : 0 );
+		v.m_tag = Tag::Bool;
+		return v;
+	}
+	// a literal: `text` has to outlive the value (see above)
+	static Value fromString( const std::string_view text )
+	{
+		Value v;
+		v.store( 0, text.data() );
+		v.store( 8, static_cast<uint32_t>( text.size() ) );
+		v.m_tag = Tag::Literal;
+		return v;
+	}
+
+	// `left + right`. short results go inline; a long one is appended in place when `left` is
+	// the newest string in its buffer and there is room after it, so building a string in a
+	// loop (`msg = msg + part;`) copies each part once, not the whole string every time
+	static Value concat( const Value& left, const Value& right );
+
+	[[nodiscard]] Type type() const
+	{
+		return m_tag == Tag::Int ? Type::Int : m_tag == Tag::Bool ? Type::Bool : Type::String;
+	}
+	[[nodiscard]] bool isString() const { return type() == Type::String; }
+
+	// no checks: the semantic analyser already knows what every expression holds.
+	// asInt() reads ints and bools alike (a bool is 0 or 1)
+	[[nodiscard]] int64_t asInt() const { return load<int64_t>( 0 ); }
+	[[nodiscard]] bool asBool() const { return asInt() != 0; }
+	// a short string's text is inside the value: the view is good while the value is
+	[[nodiscard]] std::string_view asString() const
+	{
+		switch ( m_tag ) {
+		case Tag::Inline:
+			return { m_bytes, static_cast<uint8_t>( m_bytes[ InlineCapacity ] ) };
+		case Tag::Shared:
+			return { buffer()->text(), load<uint32_t>( 8 ) };
+		default:
+			return { load<const char*>( 0 ), load<uint32_t>( 8 ) };
+		}
+	}
+
+	// same type and same value; strings compare their text, however it is stored
+	friend bool operator==( const Value& left, const Value& right )
+	{
+		if ( left.type() != right.type() ) {
+			return false;
+		}
+		return left.isString() ? left.asString() == right.asString() : left.asInt() == right.asInt();
+	}
+
+ private:
+	enum class Tag : uint8_t
+	{
+		Int,
+		Bool,
+		Literal,
+		Inline,
+		Shared
+	};
+
+	// bytes 0-7: the int, or the literal's pointer, or the StringBuffer. bytes 8-11: a string's
+	// length. a short string uses 0-13 for its text and 14 for its length
+	alignas( 8 ) char m_bytes[ 15 ] = {};
+	Tag m_tag = Tag::Int;
+
+	// memcpy in and out of the bytes: one plain load or store once compiled
+	template <typename T>
+	T load( const size_t at ) const
+	{
+		T value;
+		std::memcpy( &value, m_bytes + at, sizeof( T ) );
+		return value;
+	}
+	template <typename T>
+	void store( const size_t at, const T value )
+	{
+		std::memcpy( m_bytes + at, &value, sizeof( T ) );
+	}
+
+	[[nodiscard]] StringBuffer* buffer() const { return load<StringBuffer*>( 0 ); }
+	static Value shared( StringBuffer* buffer, uint32_t length );
+
+	void copyBytes( const Value& other )
+	{
+		std::memcpy( m_bytes, other.m_bytes, sizeof( m_bytes ) );
+		m_tag = other.m_tag;
+	}
+	void copyFrom( const Value& other )
+	{
+		copyBytes( other );
+		retain();
+	}
+	void retain() const
+	{
+		if ( m_tag == Tag::Shared ) {
+			++buffer()->refs;
+		}
+	}
+	void release()
+	{
+		if ( m_tag == Tag::Shared && --buffer()->refs == 0 ) {
+			freeBuffer( buffer() );
+		}
+	}
+	static void freeBuffer( StringBuffer* buffer );
+};
+static_assert( sizeof( Value ) == 16 );
+
+// every variable of the program, by slot: a read is an index, no hashing and no lookup
+struct Environment {
+	std::vector<Value> variables;	// one per slot of the frame, all there from the start
+
+	// every slot back to the int 0, as many as the analyser handed out (its frameSize())
+	void reset( const Slot frameSize ) { variables.assign( frameSize, Value() ); }
+
+	// the analyser only hands out slots below the frame size, so no checks
+	void set( const Slot slot, Value value ) { variables[ slot ] = std::move( value ); }
+	[[nodiscard]] const Value& get( const Slot slot ) const { return variables[ slot ]; }
+};
@@ -0,0 +1,210 @@
+// src/interpreter/vm.cpp
+#include "vm.hpp"
+#include <iterator>
+#include "../headers/tokeniser.hpp"
+#include "interpreter.hpp"
+
+// How the loop gets from one instruction to the next, picked at build time (CARP_VM_DISPATCH in
+// CMakeLists.txt):
+//   computed goto  every handler ends in its own `goto *handlers[ next op ]`. GCC and Clang only
+//                  (labels as values are an extension), but each handler's jump gets its own
+//                  slot in the branch predictor, which learns "after a Less comes a JumpIfTrue"
+//   switch         one shared jump at the top of the loop, plain C++ (MSVC)
+// Both run the handlers below, written once, so they can't behave differently.
+#ifndef CARP_VM_COMPUTED_GOTO
+#if defined( __GNUC__ ) || defined( __clang__ )
+#define CARP_VM_COMPUTED_GOTO 1
+#else
+#define CARP_VM_COMPUTED_GOTO 0
+#endif
+#endif
+
+#if CARP_VM_COMPUTED_GOTO && !( defined( __GNUC__ ) || defined( __clang__ ) )
+#error "computed goto dispatch needs GCC or Clang, configure with -DCARP_VM_DISPATCH=SWITCH"
+#endif
+
+const char* VirtualMachine::dispatch()
+{
+	return CARP_VM_COMPUTED_GOTO ? "computed goto" : "switch";
+}
+
+#if CARP_VM_COMPUTED_GOTO
+// `&&label` is a GNU extension, -Wpedantic would flag every entry of the table
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+void VirtualMachine::run( const Bytecode& program )
+{
+	m_registers.assign( program.registerCount, 0 );
+	m_strings.assign( program.registerCount, Value() );
+	// a literal is a view of the constant pool's text: loading one copies 16 bytes, no text
+	m_constants.clear();
+	for ( const std::string& text : program.strings ) {
+		m_constants.push_back( Value::fromString( text ) );
+	}
+
+	int64_t* const r = m_registers.data();
+	Value* const s = m_strings.data();
+	const int64_t* const ints = program.ints.data();
+	const Instr* const code = program.code.data();
+	const Instr* pc = code;	 // the instruction being run
+
+	// ints wrap on overflow like in the tree walker: the arithmetic is done unsigned
+	const auto u = []( const int64_t v ) { return static_cast<uint64_t>( v ); };
+
+#if CARP_VM_COMPUTED_GOTO
+	// one entry per Op, in the enum's order
+	static const void* const handlers[] = {
+		&&op_LoadInt,	 &&op_LoadStr,	 &&op_Move,			&&op_MoveStr,	 &&op_Add,
+		&&op_Sub,		 &&op_Mul,		 &&op_Div,			&&op_Less,		 &&op_LessEq,
+		&&op_Greater,	 &&op_GreaterEq, &&op_Equal,		&&op_NotEqual, &&op_StrEqual,
+		&&op_StrNotEqual, &&op_Concat,	 &&op_Jump,			&&op_JumpIfFalse, &&op_JumpIfTrue,
+		&&op_Halt,
+	};
+	static_assert( std::size( handlers ) == static_cast<size_t>( Op::Halt ) + 1 );
+#define HANDLER( name ) op_##name:
+#define DISPATCH() goto* handlers[ static_cast<size_t>( pc->op ) ]
+	DISPATCH();
+#else
+#define HANDLER( name ) case Op::name:
+#define DISPATCH() continue
+	for ( ;; ) {
+		switch ( pc->op ) {
+#endif
+#define NEXT() \
+	++pc;       \
+	DISPATCH()
+
+	HANDLER( LoadInt )
+	{
+		r[ pc->a ] = ints[ pc->b ];
+		NEXT();
+	}
+	HANDLER( LoadStr )
+	{
+		s[ pc->a ] = m_constants[ pc->b ];
+		NEXT();
+	}
+	HANDLER( Move )
+	{
+		r[ pc->a ] = r[ pc->b ];
+		NEXT();
+	}
+	HANDLER( MoveStr )
+	{
+		s[ pc->a ] = s[ pc->b ];
+		NEXT();
+	}
+
+	HANDLER( Add )
+	{
+		r[ pc->a ] = static_cast<int64_t>( u( r[ pc->b ] ) + u( r[ pc->c ] ) );
+		NEXT();
+	}
+	HANDLER( Sub )
+	{
+		r[ pc->a ] = static_cast<int64_t>( u( r[ pc->b ] ) - u( r[ pc->c ] ) );
+		NEXT();
+	}
+	HANDLER( Mul )
+	{
+		r[ pc->a ] = static_cast<int64_t>( u( r[ pc->b ] ) * u( r[ pc->c ] ) );
+		NEXT();
+	}
+	HANDLER( Div )
+	{
+		// the zero and INT64_MIN / -1 rules live in one place
+		r[ pc->a ] = Interpreter::binaryOp( TokenType::T_slash, r[ pc->b ], r[ pc->c ] );
+		NEXT();
+	}
+
+	HANDLER( Less )
+	{
+		r[ pc->a ] = r[ pc->b ] < r[ pc->c ];
+		NEXT();
+	}
+	HANDLER( LessEq )
+	{
+		r[ pc->a ] = r[ pc->b ] <= r[ pc->c ];
+		NEXT();
+	}
+	HANDLER( Greater )
+	{
+		r[ pc->a ] = r[ pc->b ] > r[ pc->c ];
+		NEXT();
+	}
+	HANDLER( GreaterEq )
+	{
+		r[ pc->a ] = r[ pc->b ] >= r[ pc->c ];
+		NEXT();
+	}
+	HANDLER( Equal )
+	{
+		r[ pc->a ] = r[ pc->b ] == r[ pc->c ];
+		NEXT();
+	}
+	HANDLER( NotEqual )
+	{
+		r[ pc->a ] = r[ pc->b ] != r[ pc->c ];
+		NEXT();
+	}
+	HANDLER( StrEqual )
+	{
+		r[ pc->a ] = s[ pc->b ].asString() == s[ pc->c ].asString();
+		NEXT();
+	}
+	HANDLER( StrNotEqual )
+	{
+		r[ pc->a ] = s[ pc->b ].asString() != s[ pc->c ].asString();
+		NEXT();
+	}
+
+	HANDLER( Concat )
+	{
+		// `msg = msg + part` names msg twice: concat reads it before the result replaces it
+		s[ pc->a ] = Value::concat( s[ pc->b ], s[ pc->c ] );
+		NEXT();
+	}
+
+	HANDLER( Jump )
+	{
+		pc = code + pc->a;
+		DISPATCH();
+	}
+	HANDLER( JumpIfFalse )
+	{
+		pc = r[ pc->a ] == 0 ? code + pc->b : pc + 1;
+		DISPATCH();
+	}
+	HANDLER( JumpIfTrue )
+	{
+		pc = r[ pc->a ] != 0 ? code + pc->b : pc + 1;
+		DISPATCH();
+	}
+	HANDLER( Halt )
+	{
+		return;
+	}
+
+#if !CARP_VM_COMPUTED_GOTO
+		}
+	}
+#endif
+#undef NEXT
+#undef DISPATCH
+#undef HANDLER
+}
+
+#if CARP_VM_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
+
+Value VirtualMachine::variable( const Slot slot, const TokenType type ) const
+{
+	if ( type == TokenType::T_string ) {
+		return m_strings.at( slot );
+	}
+	const int64_t reg = m_registers.at( slot );
+	return type == TokenType::T_bool ? Value::fromBool( reg != 0 ) : Value::fromInt( reg );
+}
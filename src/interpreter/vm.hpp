@@ -0,0 +1,28 @@
+// src/interpreter/vm.hpp
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../headers/parser.hpp"
+#include "bytecode.hpp"
+#include "value.hpp"
+
+// Runs Bytecode (see bytecode.hpp): one loop over the instructions, dispatching on the opcode,
+// every operand an index into a flat array of int64_t registers. No tree to walk, no
+// node to look at, no Value to copy: only the string ops touch the Values in m_strings.
+class VirtualMachine {
+ public:
+	void run( const Bytecode& program );
+	// how this build's loop dispatches: "computed goto" or "switch" (see vm.cpp)
+	static const char* dispatch();
+
+	// a variable after the run, the way the tree walker (Interpreter) holds it.
+	// `type` is its static type, the registers don't say what they hold
+	[[nodiscard]] Value variable( Slot slot, TokenType type ) const;
+
+ private:
+	std::vector<int64_t> m_registers;
+	std::vector<Value> m_strings;	  // the string registers, as many as there are int ones
+	std::vector<Value> m_constants;	// the program's string literals, viewing its `strings`
+};
@@ -0,0 +1,457 @@
+// src\lexScan.cpp
+#include "headers/lexScan.hpp"
+
+#include <bit>
+#include <cstdint>
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+#define CARP_LEXSCAN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 instructions inside functions that ask for them,
+// MSVC lets any function use the intrinsics
+#if defined( CARP_LEXSCAN_X86 ) && ( defined( __GNUC__ ) || defined( __clang__ ) )
+#define CARP_AVX2_TARGET __attribute__( ( target( "avx2" ) ) )
+#else
+#define CARP_AVX2_TARGET
+#endif
+
+namespace lexscan
+{
+
+/* --------------------------------------------------------------------------------------------- */
+// # Scalar kernels: the reference behaviour, and the tail of every vector loop
+
+namespace
+{
+
+bool isIdentChar( const char c )
+{
+	const auto u = static_cast<unsigned char>( c );
+	return ( ( u | 0x20 ) >= 'a' && ( u | 0x20 ) <= 'z' ) || ( u >= '0' && u <= '9' ) || u == '_';
+}
+
+const char* skipWhitespaceScalar( const char* p, const char* end )
+{
+	while ( p < end && ( *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' ) ) {
+		++p;
+	}
+	return p;
+}
+
+const char* skipIdentifierScalar( const char* p, const char* end )
+{
+	while ( p < end && isIdentChar( *p ) ) {
+		++p;
+	}
+	return p;
+}
+
+const char* skipDigitsScalar( const char* p, const char* end )
+{
+	while ( p < end && *p >= '0' && *p <= '9' ) {
+		++p;
+	}
+	return p;
+}
+
+const char* findLineEndScalar( const char* p, const char* end )
+{
+	while ( p < end && *p != '\n' ) {
+		++p;
+	}
+	return p;
+}
+
+const char* findBlockCommentEndScalar( const char* p, const char* end )
+{
+	while ( p + 1 < end && !( p[ 0 ] == '*' && p[ 1 ] == '/' ) ) {
+		++p;
+	}
+	return p + 1 < end ? p : end;
+}
+
+const char* findStringEndScalar( const char* p, const char* end )
+{
+	while ( p < end && *p != '"' && *p != '\n' && *p != '\0' ) {
+		++p;
+	}
+	return p;
+}
+
+}	// namespace
+
+/* --------------------------------------------------------------------------------------------- */
+// # SSE2 kernels: 16 bytes per step, every x86-64 CPU has these
+
+#ifdef CARP_LEXSCAN_X86
+namespace
+{
+
+// one bit per byte that matches
+unsigned mask16( const __m128i m )
+{
+	return static_cast<unsigned>( _mm_movemask_epi8( m ) );
+}
+
+__m128i load16( const char* p )
+{
+	return _mm_loadu_si128( reinterpret_cast<const __m128i*>( p ) );
+}
+
+// bytes in [lo, hi]; signed compares are fine because every bound is plain ASCII
+__m128i inRange16( const __m128i v, const char lo, const char hi )
+{
+	return _mm_and_si128( _mm_cmpgt_epi8( v, _mm_set1_epi8( static_cast<char>( lo - 1 ) ) ),
+								 _mm_cmplt_epi8( v, _mm_set1_epi8( static_cast<char>( hi + 1 ) ) ) );
+}
+
+__m128i isWhitespace16( const __m128i v )
+{
+	return _mm_or_si128(
+		 _mm_or_si128( _mm_cmpeq_epi8( v, _mm_set1_epi8( ' ' ) ),
+							_mm_cmpeq_epi8( v, _mm_set1_epi8( '\t' ) ) ),
+		 _mm_or_si128( _mm_cmpeq_epi8( v, _mm_set1_epi8( '\r' ) ),
+							_mm_cmpeq_epi8( v, _mm_set1_epi8( '\n' ) ) ) );
+}
+
+__m128i isIdent16( const __m128i v )
+{
+	const __m128i lower = _mm_or_si128( v, _mm_set1_epi8( 0x20 ) );
+	return _mm_or_si128( _mm_or_si128( inRange16( lower, 'a', 'z' ), inRange16( v, '0', '9' ) ),
+								_mm_cmpeq_epi8( v, _mm_set1_epi8( '_' ) ) );
+}
+
+const char* skipWhitespaceSse2( const char* p, const char* end )
+{
+	for ( ; p + 16 <= end; p += 16 ) {
+		if ( const unsigned stop = ~mask16( isWhitespace16( load16( p ) ) ) & 0xFFFFu ) {
+			return p + std::countr_zero( stop );
+		}
+	}
+	return skipWhitespaceScalar( p, end );
+}
+
+const char* skipIdentifierSse2( const char* p, const char* end )
+{
+	for ( ; p + 16 <= end; p += 16 ) {
+		if ( const unsigned stop = ~mask16( isIdent16( load16( p ) ) ) & 0xFFFFu ) {
+			return p + std::countr_zero( stop );
+		}
+	}
+	return skipIdentifierScalar( p, end );
+}
+
+const char* skipDigitsSse2( const char* p, const char* end )
+{
+	for ( ; p + 16 <= end; p += 16 ) {
+		if ( const unsigned stop = ~mask16( inRange16( load16( p ), '0', '9' ) ) & 0xFFFFu ) {
+			return p + std::countr_zero( stop );
+		}
+	}
+	return skipDigitsScalar( p, end );
+}
+
+const char* findLineEndSse2( const char* p, const char* end )
+{
+	const __m128i nl = _mm_set1_epi8( '\n' );
+	for ( ; p + 16 <= end; p += 16 ) {
+		if ( const unsigned hit = mask16( _mm_cmpeq_epi8( load16( p ), nl ) ) ) {
+			return p + std::countr_zero( hit );
+		}
+	}
+	return findLineEndScalar( p, end );
+}
+
+const char* findBlockCommentEndSse2( const char* p, const char* end )
+{
+	const __m128i star = _mm_set1_epi8( '*' );
+	const __m128i slash = _mm_set1_epi8( '/' );
+	// compare the block and the block shifted by one, a hit is a '*' directly followed by '/'
+	for ( ; p + 17 <= end; p += 16 ) {
+		const __m128i pair = _mm_and_si128( _mm_cmpeq_epi8( load16( p ), star ),
+														_mm_cmpeq_epi8( load16( p + 1 ), slash ) );
+		if ( const unsigned hit = mask16( pair ) ) {
+			return p + std::countr_zero( hit );
+		}
+	}
+	return findBlockCommentEndScalar( p, end );
+}
+
+const char* findStringEndSse2( const char* p, const char* end )
+{
+	for ( ; p + 16 <= end; p += 16 ) {
+		const __m128i v = load16( p );
+		const __m128i stop =
+			 _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( v, _mm_set1_epi8( '"' ) ),
+												  _mm_cmpeq_epi8( v, _mm_set1_epi8( '\n' ) ) ),
+								_mm_cmpeq_epi8( v, _mm_setzero_si128() ) );
+		if ( const unsigned hit = mask16( stop ) ) {
+			return p + std::countr_zero( hit );
+		}
+	}
+	return findStringEndScalar( p, end );
+}
+
+/* --------------------------------------------------------------------------------------------- */
+// # AVX2 kernels: same algorithms, 32 bytes per step
+
+CARP_AVX2_TARGET uint32_t mask32( const __m256i m )
+{
+	return static_cast<uint32_t>( _mm256_movemask_epi8( m ) );
+}
+
+CARP_AVX2_TARGET __m256i load32( const char* p )
+{
+	return _mm256_loadu_si256( reinterpret_cast<const __m256i*>( p ) );
+}
+
+CARP_AVX2_TARGET __m256i inRange32( const __m256i v, const char lo, const char hi )
+{
+	return _mm256_and_si256(
+		 _mm256_cmpgt_epi8( v, _mm256_set1_epi8( static_cast<char>( lo - 1 ) ) ),
+		 _mm256_cmpgt_epi8( _mm256_set1_epi8( static_cast<char>( hi + 1 ) ), v ) );
+}
+
+CARP_AVX2_TARGET __m256i isWhitespace32( const __m256i v )
+{
+	return _mm256_or_si256(
+		 _mm256_or_si256( _mm256_cmpeq_epi8( v, _mm256_set1_epi8( ' ' ) ),
+							  _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '\t' ) ) ),
+		 _mm256_or_si256( _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '\r' ) ),
+							  _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '\n' ) ) ) );
+}
+
+CARP_AVX2_TARGET __m256i isIdent32( const __m256i v )
+{
+	const __m256i lower = _mm256_or_si256( v, _mm256_set1_epi8( 0x20 ) );
+	return _mm256_or_si256(
+		 _mm256_or_si256( inRange32( lower, 'a', 'z' ), inRange32( v, '0', '9' ) ),
+		 _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '_' ) ) );
+}
+
+CARP_AVX2_TARGET const char* skipWhitespaceAvx2( const char* p, const char* end )
+{
+	for ( ; p + 32 <= end; p += 32 ) {
+		if ( const uint32_t stop = ~mask32( isWhitespace32( load32( p ) ) ) ) {
+			return p + std::countr_zero( stop );
+		}
+	}
+	return skipWhitespaceSse2( p, end );
+}
+
+CARP_AVX2_TARGET const char* skipIdentifierAvx2( const char* p, const char* end )
+{
+	for ( ; p + 32 <= end; p += 32 ) {
+		if ( const uint32_t stop = ~mask32( isIdent32( load32( p ) ) ) ) {
+			return p + std::countr_zero( stop );
+		}
+	}
+	return skipIdentifierSse2( p, end );
+}
+
+CARP_AVX2_TARGET const char* skipDigitsAvx2( const char* p, const char* end )
+{
+	for ( ; p + 32 <= end; p += 32 ) {
+		if ( const uint32_t stop = ~mask32( inRange32( load32( p ), '0', '9' ) ) ) {
+			return p + std::countr_zero( stop );
+		}
+	}
+	return skipDigitsSse2( p, end );
+}
+
+CARP_AVX2_TARGET const char* findLineEndAvx2( const char* p, const char* end )
+{
+	const __m256i nl = _mm256_set1_epi8( '\n' );
+	for ( ; p + 32 <= end; p += 32 ) {
+		if ( const uint32_t hit = mask32( _mm256_cmpeq_epi8( load32( p ), nl ) ) ) {
+			return p + std::countr_zero( hit );
+		}
+	}
+	return findLineEndSse2( p, end );
+}
+
+CARP_AVX2_TARGET const char* findBlockCommentEndAvx2( const char* p, const char* end )
+{
+	const __m256i star = _mm256_set1_epi8( '*' );
+	const __m256i slash = _mm256_set1_epi8( '/' );
+	for ( ; p + 33 <= end; p += 32 ) {
+		const __m256i pair = _mm256_and_si256( _mm256_cmpeq_epi8( load32( p ), star ),
+															_mm256_cmpeq_epi8( load32( p + 1 ), slash ) );
+		if ( const uint32_t hit = mask32( pair ) ) {
+			return p + std::countr_zero( hit );
+		}
+	}
+	return findBlockCommentEndSse2( p, end );
+}
+
+CARP_AVX2_TARGET const char* findStringEndAvx2( const char* p, const char* end )
+{
+	for ( ; p + 32 <= end; p += 32 ) {
+		const __m256i v = load32( p );
+		const __m256i stop =
+			 _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '"' ) ),
+														  _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '\n' ) ) ),
+								  _mm256_cmpeq_epi8( v, _mm256_setzero_si256() ) );
+		if ( const uint32_t hit = mask32( stop ) ) {
+			return p + std::countr_zero( hit );
+		}
+	}
+	return findStringEndSse2( p, end );
+}
+
+bool cpuHasAvx2()
+{
+#if defined( _MSC_VER ) && !defined( __clang__ )
+	int regs[ 4 ]{};
+	__cpuid( regs, 0 );
+	if ( regs[ 0 ] < 7 ) {
+		return false;
+	}
+	__cpuid( regs, 1 );
+	const bool osSavesYmm = ( regs[ 2 ] & ( 1 << 27 ) ) && ( _xgetbv( 0 ) & 0x6 ) == 0x6;
+	__cpuidex( regs, 7, 0 );
+	return osSavesYmm && ( regs[ 1 ] & ( 1 << 5 ) );
+#else
+	return __builtin_cpu_supports( "avx2" );
+#endif
+}
+
+}	// namespace
+#endif	// CARP_LEXSCAN_X86
+
+/* --------------------------------------------------------------------------------------------- */
+// # Dispatch
+
+namespace
+{
+
+struct Kernels {
+	const char* ( *skipWhitespace )( const char*, const char* );
+	const char* ( *skipIdentifier )( const char*, const char* );
+	const char* ( *skipDigits )( const char*, const char* );
+	const char* ( *findLineEnd )( const char*, const char* );
+	const char* ( *findBlockCommentEnd )( const char*, const char* );
+	const char* ( *findStringEnd )( const char*, const char* );
+};
+
+constexpr Kernels g_scalar{
+	.skipWhitespace = skipWhitespaceScalar,
+	.skipIdentifier = skipIdentifierScalar,
+	.skipDigits = skipDigitsScalar,
+	.findLineEnd = findLineEndScalar,
+	.findBlockCommentEnd = findBlockCommentEndScalar,
+	.findStringEnd = findStringEndScalar,
+};
+#ifdef CARP_LEXSCAN_X86
+constexpr Kernels g_sse2{
+	.skipWhitespace = skipWhitespaceSse2,
+	.skipIdentifier = skipIdentifierSse2,
+	.skipDigits = skipDigitsSse2,
+	.findLineEnd = findLineEndSse2,
+	.findBlockCommentEnd = findBlockCommentEndSse2,
+	.findStringEnd = findStringEndSse2,
+};
+constexpr Kernels g_avx2{
+	.skipWhitespace = skipWhitespaceAvx2,
+	.skipIdentifier = skipIdentifierAvx2,
+	.skipDigits = skipDigitsAvx2,
+	.findLineEnd = findLineEndAvx2,
+	.findBlockCommentEnd = findBlockCommentEndAvx2,
+	.findStringEnd = findStringEndAvx2,
+};
+#endif
+
+Level detectLevel()
+{
+#ifdef CARP_LEXSCAN_X86
+	return cpuHasAvx2() ? Level::AVX2 : Level::SSE2;
+#else
+	return Level::Scalar;
+#endif
+}
+
+const Kernels& kernelsFor( const Level level )
+{
+	switch ( level ) {
+#ifdef CARP_LEXSCAN_X86
+	case Level::AVX2:
+		return g_avx2;
+	case Level::SSE2:
+		return g_sse2;
+#endif
+	default:
+		return g_scalar;
+	}
+}
+
+// picked once, before main() runs
+const Level g_best = detectLevel();
+Level g_active = g_best;
+const Kernels* g_kernels = &kernelsFor( g_best );
+
+}	// namespace
+
+Level bestLevel()
+{
+	return g_best;
+}
+
+Level activeLevel()
+{
+	return g_active;
+}
+
+void setLevel( const Level level )
+{
+	g_active = level <= g_best ? level : g_best;
+	g_kernels = &kernelsFor( g_active );
+}
+
+const char* levelName( const Level level )
+{
+	switch ( level ) {
+	case Level::AVX2:
+		return "AVX2";
+	case Level::SSE2:
+		return "SSE2";
+	default:
+		return "scalar";
+	}
+}
+
+const char* skipWhitespace( const char* p, const char* end )
+{
+	return g_kernels->skipWhitespace( p, end );
+}
+
+const char* skipIdentifier( const char* p, const char* end )
+{
+	return g_kernels->skipIdentifier( p, end );
+}
+
+const char* skipDigits( const char* p, const char* end )
+{
+	return g_kernels->skipDigits( p, end );
+}
+
+const char* findLineEnd( const char* p, const char* end )
+{
+	return g_kernels->findLineEnd( p, end );
+}
+
+const char* findBlockCommentEnd( const char* p, const char* end )
+{
+	return g_kernels->findBlockCommentEnd( p, end );
+}
+
+const char* findStringEnd( const char* p, const char* end )
+{
+	return g_kernels->findStringEnd( p, end );
+}
+
+}	// namespace lexscan
@@ -0,0 +1,24 @@
+// src\location.cpp
+#include "headers/location.hpp"
+
+#include <algorithm>
+
+#include "headers/lexScan.hpp"
+
+LineColumn LineTable::resolve( const Location loc ) const
+{
+	if ( m_lineStarts.empty() ) {
+		// first diagnostic: find every new line once (same SIMD scan the // comments use)
+		m_lineStarts.push_back( 0 );
+		const char* end = m_source.data() + m_source.size();
+		for ( const char* p = lexscan::findLineEnd( m_source.data(), end ); p != end;
+				p = lexscan::findLineEnd( p + 1, end ) ) {
+			m_lineStarts.push_back( static_cast<uint32_t>( p + 1 - m_source.data() ) );
+		}
+	}
+
+	// the last line start at or before the offset is the line it's on
+	const auto after = std::upper_bound( m_lineStarts.begin(), m_lineStarts.end(), loc.offset );
+	const auto line = static_cast<size_t>( after - m_lineStarts.begin() );
+	return { line, loc.offset - *( after - 1 ) + size_t{ 1 } };
+}
@@ -1,68 +1,370 @@
 // Carp lang src\main.cpp
 
-#include <fstream>
+#include <charconv>
 #include <iostream>
-#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "headers/SemanticAnalyser.hpp"
+#include "headers/astCache.hpp"
+#include "headers/constantFolder.hpp"
+#include "headers/deadCode.hpp"
+#include "headers/flatAst.hpp"
 #include "headers/parser.hpp"
+#include "headers/sourceFile.hpp"
 #include "headers/tokeniser.hpp"
+#include "interpreter/compiler.hpp"
+#include "interpreter/interpreter.hpp"
+#include "interpreter/vm.hpp"
 
 // import tokeniser;
 // import parser;
 // import SemanticAnalyser; // doesn't work
 // import utils;
 
+// command line switches; the first non-switch argument is the input file
+struct Options {
+	std::string path;
+	bool stream = false;	 // --stream: parser pulls tokens on demand, no token dump
+	unsigned lexThreads = 1;	// --lex-threads=N: lex big files on N threads (0 = all cores)
+	bool flat = false;			// --flat: build and check the flat (struct of arrays) AST instead
+	size_t maxDepth = Parser::DefaultMaxDepth;	// --max-depth=N: deepest nesting the parser accepts
+	bool cache = false;	 // --cache: reuse the checked AST in <file>c (written on a miss); implies --flat
+	std::string cacheDir;	// --cache-dir=DIR: same, but the cache files live in DIR
+	int optLevel = 0;			// -O0: run what was written, -O1: fold constants first
+	bool run = false;			// --run: run the program on the bytecode VM, print its variables
+	bool treeWalk = false;	 // --tree-walk: --run, but on the tree-walking interpreter
+	bool verifyVm = false;	 // --verify-vm: --run on both, and check they end up the same
+};
+
+// the N of a --switch=N, false if it isn't a plain non-negative number
+template <typename T>
+static bool parseCount( const std::string_view text, T& out )
+{
+	const auto [ end, ec ] = std::from_chars( text.data(), text.data() + text.size(), out );
+	return ec == std::errc() && end == text.data() + text.size();
+}
+
+static bool parseArgs( const int argc, char* argv[], Options& opts )
+{
+	for ( int i = 1; i < argc; ++i ) {
+		const std::string_view arg = argv[ i ];
+		if ( arg == "--stream" ) {
+			opts.stream = true;
+		} else if ( arg == "-O0" || arg == "-O1" ) {
+			opts.optLevel = arg[ 2 ] - '0';
+		} else if ( arg == "--run" ) {
+			opts.run = true;
+		} else if ( arg == "--tree-walk" ) {
+			opts.run = opts.treeWalk = true;
+		} else if ( arg == "--verify-vm" ) {
+			opts.run = opts.verifyVm = true;
+		} else if ( arg == "--flat" ) {
+			opts.flat = true;
+		} else if ( arg == "--cache" ) {
+			opts.cache = opts.flat = true;	// the cache holds a flat AST
+		} else if ( arg.starts_with( "--cache-dir=" ) ) {
+			opts.cacheDir = arg.substr( 12 );
+			opts.cache = opts.flat = true;
+		} else if ( arg.starts_with( "--lex-threads=" ) ) {
+			const std::string_view count = arg.substr( 14 );
+			if ( !parseCount( count, opts.lexThreads ) ) {
+				std::cerr << "Invalid thread count: " << count << '\n';
+				return false;
+			}
+		} else if ( arg.starts_with( "--max-depth=" ) ) {
+			const std::string_view depth = arg.substr( 12 );
+			if ( !parseCount( depth, opts.maxDepth ) || opts.maxDepth == 0 ) {
+				std::cerr << "Invalid nesting depth: " << depth << '\n';
+				return false;
+			}
+			// the passes after the parser recurse, deeper than this wouldn't fit in the stack
+			if ( opts.maxDepth > Parser::MaxDepthLimit ) {
+				std::cerr << "Nesting depth " << depth << " is over the limit of "
+							 << Parser::MaxDepthLimit << '\n';
+				return false;
+			}
+		} else if ( arg.starts_with( "-" ) && arg != "-" ) {	 // "-" alone is stdin
+			std::cerr << "Unknown option: " << arg << '\n';
+			return false;
+		} else {
+			opts.path = arg;
+		}
+	}
+	return true;
+}
+
+// -O1: constant folding and propagation, then dead code elimination (which gets to see the
+// conditions the folder worked out) on the checked AST, then the AST they leave
+static void optimise( const Options& opts, CompilationUnit& unit, FlatAst& flat )
+{
+	ConstantFolder folder;
+	DeadCodeEliminator dce;
+	if ( opts.flat ) {
+		folder.fold( flat );
+		dce.run( flat );
+	} else {
+		folder.fold( unit );
+		dce.run( unit );
+	}
+	std::cout << "\n-O1: " << folder.foldedCount() << " operators folded, "
+				 << folder.propagatedCount() << " variable reads replaced by constants, "
+				 << dce.removedCount() << " dead nodes removed\n";
+
+	if ( opts.flat ) {
+		for ( const NodeIndex stmt : flat.program ) {
+			flat.print( stmt );
+		}
+	} else {
+		for ( const Stmt* stmt : unit.program ) {
+			stmt->print();
+		}
+	}
+}
+
+// how --run shows a value: the same way the source would write it
+static void printValue( const Value& value )
+{
+	switch ( value.type() ) {
+	case Value::Type::String:
+		std::cout << '"' << value.asString() << '"';
+		return;
+	case Value::Type::Bool:
+		std::cout << ( value.asBool() ? "true" : "false" );
+		return;
+	case Value::Type::Int:
+		std::cout << value.asInt();
+		return;
+	}
+}
+
+// runs `fn` and returns the runtime error it stopped with, "" if it ran to the end
+template <typename Fn>
+static std::string runtimeErrorOf( Fn&& fn )
+{
+	try {
+		fn();
+	} catch ( const std::exception& err ) {
+		return err.what();
+	}
+	return {};
+}
+
+// --run: the checked (and with -O1 optimised) program on the bytecode VM, or the tree walker.
+// prints every top-level variable at the end (their slots are never reused, so the value is
+// still there). --verify-vm runs both and compares every slot; returns false if they differ
+static bool runProgram( const Options& opts, const CompilationUnit& unit, const FlatAst& flat,
+								const Slot frameSize )
+{
+	struct Global {
+		std::string_view name;
+		Slot slot;
+		TokenType type;
+	};
+	std::vector<Global> globals;
+	if ( opts.flat ) {
+		for ( const NodeIndex stmt : flat.program ) {
+			if ( flat.kinds[ stmt ] == NodeKind::VarDecl ) {
+				globals.push_back( { flat.name( stmt ), flat.c[ stmt ], flat.tags[ stmt ] } );
+			}
+		}
+	} else {
+		for ( const Stmt* stmt : unit.program ) {
+			if ( stmt->kind == NodeKind::VarDecl ) {
+				const auto& var = as<VarDeclStmt>( stmt );
+				globals.push_back( { var.name, var.slot, var.type } );
+			}
+		}
+	}
+
+	Interpreter tree;
+	std::string treeError;
+	if ( opts.treeWalk || opts.verifyVm ) {
+		treeError = runtimeErrorOf( [ & ] {
+			opts.flat ? tree.execute( flat, frameSize ) : tree.execute( unit.program, frameSize );
+		} );
+	}
+	VirtualMachine vm;
+	Bytecode code;
+	std::string vmError;
+	if ( !opts.treeWalk ) {
+		vmError = runtimeErrorOf( [ & ] {
+			BytecodeCompiler compiler;
+			code = opts.flat ? compiler.compile( flat, frameSize )
+								  : compiler.compile( unit.program, frameSize );
+			vm.run( code );
+		} );
+	}
+
+	const std::string& error = opts.treeWalk ? treeError : vmError;
+	if ( !error.empty() ) {
+		std::cerr << RED << "Runtime Error: \n   " << error << CoRESET << "\n";
+	} else {
+		std::cout << '\n';
+		for ( const auto& [ name, slot, type ] : globals ) {
+			std::cout << name << " = ";
+			printValue( opts.treeWalk ? tree.variable( slot ) : vm.variable( slot, type ) );
+			std::cout << '\n';
+		}
+	}
+
+	if ( !opts.verifyVm ) {
+		return true;
+	}
+	// the tree walker is the reference: the VM has to stop with the same error, or leave every
+	// variable with the same value
+	if ( treeError != vmError ) {
+		std::cerr << RED << "VM mismatch: the tree walker stopped with \"" << treeError
+					 << "\", the VM with \"" << vmError << "\"" << CoRESET << '\n';
+		return false;
+	}
+	if ( error.empty() ) {
+		for ( Slot slot = 0; slot < frameSize; ++slot ) {
+			// the registers don't say what they hold: read each as what the tree walker left there
+			const Value expected = tree.variable( slot );
+			TokenType type = TokenType::T_int;
+			if ( expected.type() == Value::Type::String ) {
+				type = TokenType::T_string;
+			} else if ( expected.type() == Value::Type::Bool ) {
+				type = TokenType::T_bool;
+			}
+			if ( vm.variable( slot, type ) != expected ) {
+				std::cerr << RED << "VM mismatch in slot " << slot << CoRESET << '\n';
+				return false;
+			}
+		}
+	}
+	std::cout << "VM matches the tree walker (" << frameSize << " slots)\n";
+	return true;
+}
+
 int main( int argc, char* argv[] )
 {
-	if ( argc <= 1 ) {
+	Options opts;
+	if ( !parseArgs( argc, argv, opts ) ) {
+		return -1;
+	}
+	if ( opts.path.empty() ) {
 		std::cout << "Please provide an input file" << '\n';
 		return -1;
 	}
 
-	std::ifstream fileIn( argv[ 1 ] );
-	if ( !fileIn ) {
+	// the source must outlive the tokens and the AST, both only hold views into it.
+	// regular files are memory-mapped, so this is the only "copy" of the text we ever have
+	SourceFile file;
+	try {
+		file = SourceFile::load( opts.path );	// "-" reads from stdin
+	} catch ( const std::exception& ) {
 		std::cerr << "Failed to open file.\n";
 		return -1;
 	}
+	const std::string_view source = file.text();
+	const LineTable lines( source );	// line:column for messages, built on first use
 
-	std::stringstream buffer;
-	buffer << fileIn.rdbuf();	// read file add put into buffer stream
+	//@ AST cache
+	FlatAst flat;	// with --flat (or --cache) the whole program as a few flat arrays
+	std::string cachePath;
+	if ( opts.cache && opts.path != "-" ) {
+		cachePath = astcache::pathFor( opts.path, opts.cacheDir, source );
+		// a hit was checked when it was written: no lexing, parsing or analysing to do
+		if ( astcache::load( cachePath, source, flat ) ) {
+			for ( const NodeIndex stmt : flat.program ) {
+				flat.print( stmt );
+			}
+			CompilationUnit none;	// the cache only ever holds a flat AST
+			if ( opts.optLevel >= 1 ) {
+				optimise( opts, none, flat );
+			}
+			if ( opts.run && !runProgram( opts, none, flat, flat.frameSize() ) ) {
+				return 1;
+			}
+			return 0;
+		}
+	}
+	bool clean = true;  // no errors so far, only a clean program is worth caching (or running)
+	Slot frameSize = 0;
 
 	//@ Tokeniser
-	Tokeniser tokeniser( buffer.str() );  // conv to str and give to tokeniser
-	auto tokens = tokeniser.tokenise();	  // get the returned tokens from the tokeniser
+	Interner interner;				  // one id per distinct name, shared by every pass
+	Tokeniser tokeniser( source, interner );	// give a view of the (sentinel-terminated) text
+	tokeniser.setParallel( opts.lexThreads );	// only kicks in for very large files
+	std::vector<Token> tokens;
+	if ( !opts.stream ) {
+		tokens = tokeniser.tokenise();  // get the returned tokens from the tokeniser
 
-	// # Token output for debugging
-	for ( const auto& [ type, value, loc ] : tokens ) {
-		std::cout << "TokenType order : " << static_cast<int>( type ) << " | Textual: '" << MAGENTA
-					 << value << CoRESET << "' " << "Pos: " << GREEN << loc.line << ":" << loc.column
-					 << CoRESET << '\n';
+		// # Token output for debugging
+		for ( const auto& [ type, symbol, value, loc ] : tokens ) {
+			const LineColumn pos = lines.resolve( loc );
+			std::cout << "TokenType order : " << static_cast<int>( type ) << " | Textual: '"
+						 << MAGENTA << value << CoRESET << "' " << "Pos: " << GREEN << pos.line << ":"
+						 << pos.column << CoRESET << '\n';
+		}
 	}
 
 	// @ Parser
-	std::vector<std::unique_ptr<Stmt>> nodes;
+	CompilationUnit unit;	// owns every AST node, they all go away with it at the end
 	try {
 
-		Parser parser( tokens );  // pass tokens to the parser
-		nodes = parser.parse();	  // start parsing and store in nodes
+		// pass tokens to the parser, or let it pull them from the tokeniser as it goes
+		if ( opts.flat ) {
+			FlatParser parser = opts.stream ? FlatParser( tokeniser, flat ) : FlatParser( tokens, flat );
+			parser.setMaxDepth( opts.maxDepth );
+			parser.parse();
 
-		for ( const auto& stmt : nodes ) {
-			stmt->print();
+			for ( const NodeIndex stmt : flat.program ) {
+				flat.print( stmt );
+			}
+		} else {
+			Parser parser = opts.stream ? Parser( tokeniser, unit ) : Parser( tokens, unit );
+			parser.setMaxDepth( opts.maxDepth );
+			parser.parse();  // start parsing, the statements land in unit.program
+
+			for ( const Stmt* stmt : unit.program ) {
+				stmt->print();
+			}
 		}
 
 	} catch ( const std::exception& err ) {
-
+		clean = false;
 		std::cerr << RED << "Parse Error: \n   " << err.what() << CoRESET << "\n";
 	}
 	// hello
 	// @ Semantic analyser
-	try {
-		SemanticAnalyser semAnalyser;
-		semAnalyser.analyse( nodes );
-	} catch ( const std::exception& err ) {
+	// only on a program that parsed: after a parse error the statements before it are still in
+	// the program, and checking half a program only adds errors the user can't act on yet
+	if ( clean ) {
+		try {
+			SemanticAnalyser semAnalyser( lines );
+			if ( opts.flat ) {
+				semAnalyser.analyse( flat );
+			} else {
+				semAnalyser.analyse( unit.program );
+			}
+			frameSize = semAnalyser.frameSize();
+		} catch ( const std::exception& err ) {
+			clean = false;
+			std::cerr << RED << "Semantic Error: \n   " << err.what() << CoRESET << "\n";
+		}
+	}
+
+	if ( clean && !cachePath.empty() ) {
+		try {
+			astcache::save( cachePath, source, flat );
+		} catch ( const std::exception& err ) {
+			std::cerr << err.what() << '\n';	// not fatal, the next run just compiles again
+		}
+	}
+
+	// @ Optimiser
+	// after the cache was written: it holds the checked program, whatever -O the next run asks for
+	if ( clean && opts.optLevel >= 1 ) {
+		optimise( opts, unit, flat );
+	}
 
-		std::cerr << RED << "Semantic Error: \n   " << err.what() << CoRESET << "\n";
+	// @ Run
+	if ( clean && opts.run && !runProgram( opts, unit, flat, frameSize ) ) {
+		return 1;
 	}
 
 	return 0;
@@ -1,29 +1,74 @@
 // src\parser.cpp
 
 #include "headers/parser.hpp"
-#include <memory>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
 #include <stdexcept>
+#include <string>
 #include <utility>
 
+#include "headers/flatAst.hpp"
 #include "headers/tokeniser.hpp"
 
 /* --------------------------------------------------------------------------------------------- */
 
-Parser::Parser( const std::vector<Token>& tokens ) : m_tokens( tokens ) {}
+template <typename Builder>
+BasicParser<Builder>::BasicParser( const std::vector<Token>& tokens,
+											  typename Builder::Output& out )
+	 : m_tokens( &tokens ), m_build{ out }
+{
+	m_current = pull();
+}
+
+template <typename Builder>
+BasicParser<Builder>::BasicParser( Tokeniser& tokeniser, typename Builder::Output& out )
+	 : m_lexer( &tokeniser ), m_build{ out }
+{
+	m_current = pull();
+}
+
+// fetches the token after m_current, either from the buffer or straight from the tokeniser
+template <typename Builder>
+Token BasicParser<Builder>::pull()
+{
+	if ( m_lexer ) {
+		return m_lexer->next();
+	}
+	if ( m_pos < m_tokens->size() ) {
+		return ( *m_tokens )[ m_pos++ ];
+	}
+	return m_tokens->back();  // keep handing out the T_EOF at the end
+}
 
 // To get the current token without moving, so we can decide
-const Token& Parser::peek() const
+template <typename Builder>
+const Token& BasicParser<Builder>::peek() const
 {
-	return m_tokens[ m_pos ];	// Returns the current token without advancing the token stream
+	return m_current;	 // Returns the current token without advancing the token stream
 }
 
 // to say the current tk is valid and move on
-const Token& Parser::advance()
+template <typename Builder>
+const Token& BasicParser<Builder>::advance()
+{
+	// Consumes(returns) the current token and advances to the next one.
+	// the returned reference is only good until the next advance(), copy it to keep it longer
+	m_previous = m_current;
+	m_current = pull();
+	return m_previous;
+}
+
+// the token consumed by the last advance()/match()
+template <typename Builder>
+const Token& BasicParser<Builder>::previous() const
 {
-	return m_tokens[ m_pos++ ];  // Consumes(returns) the current token and advances to the next one
+	return m_previous;
 }
 
-bool Parser::match( const TokenType type )
+template <typename Builder>
+bool BasicParser<Builder>::match( const TokenType type )
 {	// If the current token matches the given type, consume it and return true
 	if ( peek().type == type ) {
 		advance();
@@ -32,10 +77,37 @@ bool Parser::match( const TokenType type )
 	return false;
 }
 
+template <typename Builder>
+void BasicParser<Builder>::setMaxDepth( const size_t levels )
+{
+	m_maxDepth = std::min( levels, MaxDepthLimit );
+}
+
+template <typename Builder>
+void BasicParser<Builder>::setHeight( const size_t height )
+{
+	if ( height > MaxExpressionHeight ) {
+		throw std::runtime_error( "Expression too long: more than " +
+										  std::to_string( MaxExpressionHeight ) + " operators deep" );
+	}
+	m_height = height;
+}
+
+// deeply nested input (usually machine generated) would otherwise recurse until the stack runs out
+template <typename Builder>
+void BasicParser<Builder>::DepthScope::nest()
+{
+	if ( ++m_parser.m_depth > m_parser.m_maxDepth ) {
+		throw std::runtime_error( "Nesting too deep: more than " +
+										  std::to_string( m_parser.m_maxDepth ) + " levels" );
+	}
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 // to ensure the token is something we want like a name (x,y etc) after int/float/string
-const Token& Parser::expect( const TokenType type, const char* msg )
+template <typename Builder>
+const Token& BasicParser<Builder>::expect( const TokenType type, const char* msg )
 {	// Ensures the current token is of the expected type.
 	// Used when the grammar requires a specific token.
 	// Throws an error if the grammar is violated.
@@ -48,129 +120,176 @@ const Token& Parser::expect( const TokenType type, const char* msg )
 
 /* --------------------------------------------------------------------------------------------- */
 
+namespace
+{
+
+// converts a number literal's digits (the lexer only lets digits through) exactly once, here.
+// `negative` is for a literal straight after a unary minus: -9223372036854775808 fits in an
+// int64 even though 9223372036854775808 on its own doesn't
+int64_t parseIntLiteral( const std::string_view digits, const bool negative )
+{
+	uint64_t magnitude = 0;
+	const char* const last = digits.data() + digits.size();
+	const auto [ end, ec ] = std::from_chars( digits.data(), last, magnitude );
+	const uint64_t limit = negative ? uint64_t( INT64_MAX ) + 1 : uint64_t( INT64_MAX );
+	if ( ec != std::errc() || end != last || magnitude > limit ) {
+		const std::string text = ( negative ? "-" : "" ) + std::string( digits );
+		throw std::runtime_error( "Integer literal out of range: " + text );
+	}
+	// two's complement negate in unsigned, so INT64_MIN doesn't overflow on the way
+	return static_cast<int64_t>( negative ? 0 - magnitude : magnitude );
+}
+
+}	// namespace
+
 // primary expression(numlit ,id, strlit) skeleton
-std::unique_ptr<Expr> Parser::parsePrimary()
+template <typename Builder>
+auto BasicParser<Builder>::parsePrimary() -> ExprRef
 {
+	m_height = 1;	// a leaf. a bracket's height is its inner expression's, which sets it again
+	// one switch on the current token instead of trying match() for every kind in turn
+	switch ( peek().type ) {
 	// num literal
-	if ( match( TokenType::T_numLit ) ) {
-		const Token& num = m_tokens[ m_pos - 1 ];
-		// After match() succeeds: match(TokenType::T_numLit)
-		// The parser has already consumed the token.
-		// So the consumed token is at: m_tokens[m_pos - 1]
-		return std::make_unique<NumberExpr>( num.value, num.loc );
+	case TokenType::T_numLit: {
+		const Token& num = advance();
+		// advance() hands back the token it just consumed
+		return m_build.number( parseIntLiteral( num.value, false ), num.loc );
 	}
 	// identifier
-	if ( match( TokenType::T_identifier ) ) {
-		const Token& id = m_tokens[ m_pos - 1 ];
-		return std::make_unique<IdentExpr>( id.value, id.loc );
+	case TokenType::T_identifier: {
+		const Token& id = advance();
+		return m_build.ident( id.value, id.symbol, id.loc );
 	}
 	// string literal
-	if ( match( TokenType::T_strLit ) ) {
-		const Token& str = m_tokens[ m_pos - 1 ];
-		return std::make_unique<StringExpr>( str.value, str.loc );
+	case TokenType::T_strLit: {
+		const Token& str = advance();
+		return m_build.string( str.value, str.loc );
 	}
-	if ( match( TokenType::T_LBrack ) ) {
+	case TokenType::T_LBrack: {
+		advance();
 		auto expr = parseExpression();
 		expect( TokenType::T_RBrack, "Expected ')'" );
 		return expr;
 	}
-
 	// bool true
-	if ( match( TokenType::T_true ) ) {
-		const Token& trueToken = m_tokens[ m_pos - 1 ];
-		return std::make_unique<BoolExpr>( true, trueToken.loc );
-	}
-	if ( match( TokenType::T_false ) ) {
-		const Token& falseToken = m_tokens[ m_pos - 1 ];
-		return std::make_unique<BoolExpr>( false, falseToken.loc );
+	case TokenType::T_true:
+		return m_build.boolean( true, advance().loc );
+	case TokenType::T_false:
+		return m_build.boolean( false, advance().loc );
+	default:
+		throw std::runtime_error( "Expected expression" );
 	}
-
-	throw std::runtime_error( "Expected expression" );
 }
 
 /* --------------------------------------------------------------------------------------------- */
+// # Expressions: precedence climbing (a Pratt parser)
 
-std::unique_ptr<Expr> Parser::parseExpression()
+namespace
 {
-	return parseEquality();	 // very limited definition for now
-}
 
-std::unique_ptr<Expr> Parser::parseComparison()
+// how tightly each infix operator binds its operands, 0 = not an infix operator.
+// higher binds tighter; every operator here is left-associative.
+// a new binary operator only needs a line here (and a type rule in the semantic analyser)
+constexpr std::array<uint8_t, 256> makeInfixPowerTable()
 {
-	auto expr = parseTerm();
-
-	while ( match( TokenType::T_GrT ) || match( TokenType::T_GrTEq ) || match( TokenType::T_LeT ) ||
-			  match( TokenType::T_LeTEq ) ) {
-		TokenType op = m_tokens[ m_pos - 1 ].type;
-		auto right = parseTerm();
-		expr = std::make_unique<BinaryExpr>( std::move( expr ), op, std::move( right ), expr->m_loc );
-	}
-	return expr;
+	std::array<uint8_t, 256> power{};
+	const auto set = [ & ]( const TokenType type, const uint8_t bp ) {
+		power[ static_cast<size_t>( type ) ] = bp;
+	};
+	set( TokenType::T_eqEq, 1 );	// == !=
+	set( TokenType::T_NotE, 1 );
+	set( TokenType::T_GrT, 2 );	// > >= < <=
+	set( TokenType::T_GrTEq, 2 );
+	set( TokenType::T_LeT, 2 );
+	set( TokenType::T_LeTEq, 2 );
+	set( TokenType::T_plus, 3 );	// + -
+	set( TokenType::T_minus, 3 );
+	set( TokenType::T_star, 4 );	// * /
+	set( TokenType::T_slash, 4 );
+	return power;
 }
 
-std::unique_ptr<Expr> Parser::parseUnary()
-{
-	if ( match( TokenType::T_minus ) ) {
-		TokenType op = m_tokens[ m_pos - 1 ].type;
-		auto right = parseUnary();
+constexpr std::array<uint8_t, 256> g_infixPower = makeInfixPowerTable();
 
-		// Treat unary minus as binary (0 - expr) ; [apparently works flawlessly]
-		auto zero = std::make_unique<NumberExpr>( "0", right->m_loc );
-		return std::make_unique<BinaryExpr>( std::move( zero ), op, std::move( right ),
-														 right->m_loc );
-	}
-	return parsePrimary();
-}
-// (* and /)
-std::unique_ptr<Expr> Parser::parseFactor()
-{
-	auto expr = parseUnary();
+// prefix minus binds tighter than any infix operator: -a * b is (-a) * b
+constexpr uint8_t g_prefixPower = 5;
 
-	while ( match( TokenType::T_star ) || match( TokenType::T_slash ) ) {
-		TokenType op = m_tokens[ m_pos - 1 ].type;
-		auto right = parseUnary();
-		expr = std::make_unique<BinaryExpr>( std::move( expr ), op, std::move( right ), expr->m_loc );
-	}
-	return expr;
+constexpr uint8_t infixPower( const TokenType type )
+{
+	return g_infixPower[ static_cast<size_t>( type ) ];
 }
 
-std::unique_ptr<Expr> Parser::parseEquality()
+static_assert( infixPower( TokenType::T_star ) > infixPower( TokenType::T_plus ) );
+static_assert( infixPower( TokenType::T_semi ) == 0 && infixPower( TokenType::T_RBrack ) == 0 );
+
+}	// namespace
+
+template <typename Builder>
+auto BasicParser<Builder>::parseExpression() -> ExprRef
 {
-	auto expr = parseComparison();
+	return parseBinary( 0 );
+}
 
-	while ( match( TokenType::T_eqEq ) || match( TokenType::T_NotE ) ) {
-		TokenType op = m_tokens[ m_pos - 1 ].type;
-		auto right = parseComparison();
-		expr = std::make_unique<BinaryExpr>( std::move( expr ), op, std::move( right ), expr->m_loc );
+// parses an operand, then keeps folding in operators that bind tighter than `minPower`.
+// a right operand is parsed with the operator's own power, so an equal-power operator after
+// it stops there and gets folded in by the caller instead: that's what makes a - b - c
+// come out as (a - b) - c
+template <typename Builder>
+auto BasicParser<Builder>::parseBinary( const uint8_t minPower ) -> ExprRef
+{
+	auto expr = parseUnary();
+	size_t height = m_height;
+	while ( true ) {
+		const TokenType op = peek().type;
+		const uint8_t power = infixPower( op );
+		if ( power <= minPower ) {
+			m_height = height;
+			return expr;	// not an operator (power 0), or one that belongs to the caller
+		}
+		advance();
+		auto right = parseBinary( power );
+		// no recursion here, but the tree gets one node taller
+		setHeight( std::max( height, m_height ) + 1 );
+		height = m_height;
+		expr = m_build.binary( expr, op, right, m_build.loc( expr ) );
 	}
-	return expr;
-	// What this does:
-	// 	Parse left side
-	// 	While we see == or !=
-	// 	Keep building tree left-associatively
 }
 
-// (+ and -)
-std::unique_ptr<Expr> Parser::parseTerm()
+template <typename Builder>
+auto BasicParser<Builder>::parseUnary() -> ExprRef
 {
-	auto expr = parseFactor();
-	while ( match( TokenType::T_plus ) || match( TokenType::T_minus ) ) {
-		TokenType op = m_tokens[ m_pos - 1 ].type;
-		auto right = parseFactor();
-		expr = std::make_unique<BinaryExpr>( std::move( expr ), op, std::move( right ), expr->m_loc );
+	DepthScope depth( *this );
+	depth.nest();	// brackets and unary minus both come through here on the way down
+	if ( peek().type == TokenType::T_minus ) {
+		const TokenType op = advance().type;
+		if ( peek().type == TokenType::T_numLit ) {
+			// -5 is just the constant -5: nothing binds tighter than a prefix minus, so the literal
+			// is the whole operand
+			const Token& num = advance();
+			m_height = 1;
+			return m_build.number( parseIntLiteral( num.value, true ), num.loc );
+		}
+		auto right = parseBinary( g_prefixPower );  // just the operand: another - or a primary
+		setHeight( m_height + 1 );
+
+		// Treat unary minus as binary (0 - expr) ; [apparently works flawlessly]
+		auto zero = m_build.number( 0, m_build.loc( right ) );
+		return m_build.binary( zero, op, right, m_build.loc( right ) );
 	}
-	return expr;
+	return parsePrimary();
 }
 
 /* --------------------------------------------------------------------------------------------- */
 
-std::unique_ptr<Stmt> Parser::parseVarDecl()
+template <typename Builder>
+auto BasicParser<Builder>::parseVarDecl() -> StmtRef
 {	// a var decl should start with a type - int/float/string
 	TokenType type = advance().type;
 	// ↑ Consume the current type token (int / float / string) and record its kind
 
 	// after var type we expect identifier and then store its name
-	const Token& nameToken = expect( TokenType::T_identifier, "Expected variable name" );
+	const Token nameToken = expect( TokenType::T_identifier, "Expected variable name" );
+	// ↑ a copy, the lookahead window moves on while the initialiser is parsed
 	// after id, we want = sign
 	expect( TokenType::T_eq, "Expected '='" );
 	// after this we expect an expression (number, string, identifier, etc)
@@ -179,27 +298,29 @@ std::unique_ptr<Stmt> Parser::parseVarDecl()
 	expect( TokenType::T_semi, "Expected ';'" );
 	// after making sure the structure is correct,
 	// we return the type, identifier and value of the var via a varStmt node
-	return std::make_unique<VarDeclStmt>( type, nameToken.value, std::move( init ), nameToken.loc );
+	return m_build.varDecl( type, nameToken.value, nameToken.symbol, init, nameToken.loc );
 }
 
 /* --------------------------------------------------------------------------------------------- */
 
-std::unique_ptr<Stmt> Parser::parseAssignment()
+template <typename Builder>
+auto BasicParser<Builder>::parseAssignment() -> StmtRef
 {
-	const Token& name = expect( TokenType::T_identifier, "Expected identifier" );
+	const Token name = expect( TokenType::T_identifier, "Expected identifier" );
 	expect( TokenType::T_eq, "Expected '='" );
 	auto value = parseExpression();
 	expect( TokenType::T_semi, "Expected ';'" );
 
-	return std::make_unique<AssignStmt>( name.value, std::move( value ), name.loc );
+	return m_build.assign( name.value, name.symbol, value, name.loc );
 }
 
 /* --------------------------------------------------------------------------------------------- */
 
-std::unique_ptr<Stmt> Parser::parseIfStmt()
+template <typename Builder>
+auto BasicParser<Builder>::parseIfStmt() -> StmtRef
 {
 	// consume if
-	const Token& ifTok = expect( TokenType::T_if, "Expected 'if'" );
+	const Token ifTok = expect( TokenType::T_if, "Expected 'if'" );
 	// expect '('
 	expect( TokenType::T_LBrack, "Expect '(' after 'if'" );
 	// parse the condition  expr
@@ -210,21 +331,21 @@ std::unique_ptr<Stmt> Parser::parseIfStmt()
 	auto thenBranch = parseStatement();	 // get the if body
 
 	// optional else branch
-	std::unique_ptr<Stmt> elseBranch = nullptr;
+	StmtRef elseBranch = Builder::NoStmt;
 	if ( match( TokenType::T_else ) ) {
 		elseBranch = parseStatement();
 	}
 
-	return std::make_unique<IfStmt>( std::move( condition ), std::move( thenBranch ), ifTok.loc,
-												std::move( elseBranch ) );
+	return m_build.ifStmt( condition, thenBranch, elseBranch, ifTok.loc );
 }
 
 /* --------------------------------------------------------------------------------------------- */
 
-std::unique_ptr<Stmt> Parser::parseWhileStmt()
+template <typename Builder>
+auto BasicParser<Builder>::parseWhileStmt() -> StmtRef
 {
 	// consume while
-	const Token& whileTok = expect( TokenType::T_while, "Expected 'while'" );
+	const Token whileTok = expect( TokenType::T_while, "Expected 'while'" );
 	// expect '('
 	expect( TokenType::T_LBrack, "Expect '(' after 'while'" );
 	// parse the condition  expr
@@ -232,33 +353,39 @@ std::unique_ptr<Stmt> Parser::parseWhileStmt()
 	// expect ')'
 	expect( TokenType::T_RBrack, "Expect ')' after 'condition'" );
 	auto whileBody = parseStatement();	// get the body
-	return std::make_unique<WhileStmt>( std::move( condition ), std::move( whileBody ),
-													whileTok.loc );
+	return m_build.whileStmt( condition, whileBody, whileTok.loc );
 }
 
 /* --------------------------------------------------------------------------------------------- */
 
-std::unique_ptr<Stmt> Parser::parseBlock()
+template <typename Builder>
+auto BasicParser<Builder>::parseBlock() -> StmtRef
 {
-	const Token& lbrace = expect( TokenType::T_LBrace, "Expected '{'" );
-
-	auto block = std::make_unique<BlockStmt>();
+	const Token lbrace = expect( TokenType::T_LBrace, "Expected '{'" );
 
+	const size_t first = m_blockScratch.size();	 // where this block's statements start
 	while ( peek().type != TokenType::T_RBrace && peek().type != TokenType::T_EOF ) {
-		block->statements.push_back( parseStatement() );
+		StmtRef st = parseStatement();  // may push (and pop) nested blocks' statements
+		m_blockScratch.push_back( st );
 	}
 	expect( TokenType::T_RBrace, "Expected '}'" );
 
-	block->m_loc = lbrace.loc;
+	// now the count is known, the builder stores them as one exactly sized run
+	StmtRef block = m_build.block(
+		 std::span<const StmtRef>( m_blockScratch ).subspan( first ), lbrace.loc );
+	m_blockScratch.resize( first );
 
 	return block;
 }
 
 /* --------------------------------------------------------------------------------------------- */
 
-std::unique_ptr<Stmt> Parser::parseStatement()
+template <typename Builder>
+auto BasicParser<Builder>::parseStatement() -> StmtRef
 {
 	// Dispatches to the correct statement parser based on the current token
+	DepthScope depth( *this );
+	depth.nest();	// blocks, if and while all nest through here
 	switch ( peek().type ) {
 	case TokenType::T_int:
 	case TokenType::T_float:
@@ -281,12 +408,25 @@ std::unique_ptr<Stmt> Parser::parseStatement()
 
 /* --------------------------------------------------------------------------------------------- */
 
-std::vector<std::unique_ptr<Stmt>> Parser::parse()
+template <typename Builder>
+void BasicParser<Builder>::parse()
 {
-	std::vector<std::unique_ptr<Stmt>> stmts;
 	while ( peek().type != TokenType::T_EOF ) {
-		stmts.push_back( parseStatement() );
+		m_build.addTopLevel( parseStatement() );
 		// Parses the entire token stream into a list of top-level statements
 	}
-	return stmts;
 }
+
+/* --------------------------------------------------------------------------------------------- */
+
+Stmt* TreeBuilder::block( const std::span<Stmt* const> statements, const Location l )
+{
+	auto* block = make<BlockStmt>();
+	block->statements = unit.arena.copyArray( statements );  // one exactly sized array
+	block->m_loc = l;
+	return block;
+}
+
+// the grammar is compiled once per kind of AST
+template class BasicParser<TreeBuilder>;
+template class BasicParser<FlatBuilder>;
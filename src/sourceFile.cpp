@@ -0,0 +1,197 @@
+// src\sourceFile.cpp
+#include "headers/sourceFile.hpp"
+
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* --------------------------------------------------------------------------------------------- */
+
+SourceFile::~SourceFile()
+{
+	release();
+}
+
+SourceFile::SourceFile( SourceFile&& other ) noexcept
+	 : m_data( std::exchange( other.m_data, "" ) ), m_size( std::exchange( other.m_size, 0 ) ),
+		m_mapBase( std::exchange( other.m_mapBase, nullptr ) ),
+		m_mapLength( std::exchange( other.m_mapLength, 0 ) ), m_owned( std::move( other.m_owned ) )
+{
+	// moving a vector keeps its buffer, so m_data stays valid for the read fallback too
+}
+
+SourceFile& SourceFile::operator=( SourceFile&& other ) noexcept
+{
+	if ( this != &other ) {
+		release();
+		m_data = std::exchange( other.m_data, "" );
+		m_size = std::exchange( other.m_size, 0 );
+		m_mapBase = std::exchange( other.m_mapBase, nullptr );
+		m_mapLength = std::exchange( other.m_mapLength, 0 );
+		m_owned = std::move( other.m_owned );
+	}
+	return *this;
+}
+
+void SourceFile::release()
+{
+	if ( m_mapBase ) {
+#ifdef _WIN32
+		UnmapViewOfFile( m_mapBase );
+#else
+		munmap( m_mapBase, m_mapLength );
+#endif
+	}
+	m_mapBase = nullptr;
+	m_mapLength = 0;
+	m_data = "";
+	m_size = 0;
+	m_owned.clear();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+SourceFile SourceFile::load( const std::string& path )
+{
+	if ( path == "-" ) {
+		return readStream( stdin );
+	}
+
+	SourceFile file;
+	if ( file.tryMap( path ) ) {
+		return file;
+	}
+
+	// not a regular file (pipe, device...) or empty: read it the old-fashioned way
+	// closed on the way out, also when readStream throws
+	const std::unique_ptr<std::FILE, decltype( &std::fclose )> stream(
+		 std::fopen( path.c_str(), "rb" ), &std::fclose );
+	if ( !stream ) {
+		throw std::runtime_error( "Failed to open file: " + path );
+	}
+	return readStream( stream.get() );
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef _WIN32
+
+bool SourceFile::tryMap( const std::string& path )
+{
+	const HANDLE fileHandle =
+		 CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+						  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+	if ( fileHandle == INVALID_HANDLE_VALUE ) {
+		throw std::runtime_error( "Failed to open file: " + path );
+	}
+
+	LARGE_INTEGER size{};
+	SYSTEM_INFO info{};
+	GetSystemInfo( &info );
+	if ( GetFileType( fileHandle ) != FILE_TYPE_DISK || !GetFileSizeEx( fileHandle, &size ) ||
+		  size.QuadPart == 0 || size.QuadPart % info.dwPageSize == 0 ) {
+		// Windows zero-fills the tail of the last page, which gives us the sentinel for free,
+		// unless the file ends exactly on a page boundary
+		CloseHandle( fileHandle );
+		return false;
+	}
+
+	const HANDLE mapping = CreateFileMappingA( fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	CloseHandle( fileHandle );
+	if ( !mapping ) {
+		return false;
+	}
+	void* view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mapping );	 // the view keeps the mapping alive
+	if ( !view ) {
+		return false;
+	}
+
+	m_mapBase = view;
+	m_mapLength = static_cast<size_t>( size.QuadPart );
+	m_data = static_cast<const char*>( view );
+	m_size = static_cast<size_t>( size.QuadPart );
+	return true;
+}
+
+#else
+
+bool SourceFile::tryMap( const std::string& path )
+{
+	const int fd = ::open( path.c_str(), O_RDONLY );
+	if ( fd < 0 ) {
+		throw std::runtime_error( "Failed to open file: " + path );
+	}
+
+	struct stat st{};
+	if ( fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) || st.st_size == 0 ) {
+		::close( fd );
+		return false;
+	}
+
+	const auto size = static_cast<size_t>( st.st_size );
+	const auto page = static_cast<size_t>( sysconf( _SC_PAGESIZE ) );
+	const size_t length = ( size / page + 1 ) * page;	// always at least one byte past the text
+
+	// reserve zeroed anonymous pages first, then map the file over the front of them.
+	// whatever follows the text is then guaranteed to read as '\0', even when the file ends
+	// exactly on a page boundary
+	void* base = mmap( nullptr, length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if ( base == MAP_FAILED ) {
+		::close( fd );
+		return false;
+	}
+	void* view = mmap( base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0 );
+	::close( fd );	// the mapping keeps the file alive
+	if ( view == MAP_FAILED ) {
+		munmap( base, length );
+		return false;
+	}
+	posix_madvise( view, size, POSIX_MADV_SEQUENTIAL );	// the tokeniser reads front to back
+
+	m_mapBase = base;
+	m_mapLength = length;
+	m_data = static_cast<const char*>( view );
+	m_size = size;
+	return true;
+}
+
+#endif
+
+/* --------------------------------------------------------------------------------------------- */
+
+SourceFile SourceFile::readStream( std::FILE* stream )
+{
+	SourceFile file;
+	std::vector<char>& buf = file.m_owned;
+
+	size_t used = 0;
+	buf.resize( 64 * 1024 );
+	while ( true ) {
+		used += std::fread( buf.data() + used, 1, buf.size() - used, stream );
+		if ( used < buf.size() ) {
+			break;  // short read means EOF or error
+		}
+		buf.resize( buf.size() * 2 );
+	}
+	if ( std::ferror( stream ) ) {
+		throw std::runtime_error( "Failed to read input" );
+	}
+
+	buf.resize( used + 1 );
+	buf[ used ] = '\0';	// the sentinel
+	file.m_data = buf.data();
+	file.m_size = used;
+	return file;
+}
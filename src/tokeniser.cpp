@@ -1,18 +1,27 @@
 // src\tokeniser.cpp
-#include <cctype>
+#include <array>
+#include <cstdint>
 #include <stdexcept>
+#include <string>
 
+#include "headers/lexScan.hpp"
 #include "headers/tokeniser.hpp"
 
 // ditto mark ('') are used in comments: means same as the line above
 
 /* Lexer rule of thumb
-Exactly ONE token per loop iteration
+Exactly ONE token per call to next()
 */
 
 // constructor init
-Tokeniser::Tokeniser( std::string source ) : m_source( std::move( source ) ) {}
-// moving the text input to the source member var
+Tokeniser::Tokeniser( const std::string_view source, Interner& interner )
+	 : m_source( source ), m_interner( &interner )
+{
+	if ( source.size() > MaxSourceBytes ) {
+		throw std::runtime_error( "Source file too large (4 GB max)" );
+	}
+}
+// only the view is stored, the text itself stays with the caller
 
 char Tokeniser::peek() const
 {
@@ -27,9 +36,15 @@ char Tokeniser::advance()
 {
 	const char c = m_source[ m_index ];	 // consume current char for use
 	m_index++;									 // increment
-	m_column++;									 // ''
 	return c;									 // return the consumed char for use
 }
+
+// moves to `stop`. new lines in between need no special care, positions are plain offsets
+void Tokeniser::advanceTo( const char* stop )
+{
+	m_index = static_cast<size_t>( stop - m_source.data() );
+}
+
 // currently using peek() and advance() for their side effects, not their return values.
 /* Example future use:
 
@@ -38,262 +53,288 @@ escape sequences \n
 comments // or block comments /
 */
 
-void Tokeniser::addToken( const TokenType tType, std::string value, const size_t startColumn )
+Token Tokeniser::makeToken( const TokenType tType, const std::string_view value,
+									const size_t startIndex ) const
 {
-	m_tokens.push_back( { tType, std::move( value ), { m_line, startColumn } } );
-	// add tokens to the dynamic array with their type, text and pos
-	// must use startcolumn meaning the column u see in IDE,
-	// when cursor is before a char
+	return { tType, NoSymbol, value, { static_cast<uint32_t>( startIndex ) } };
+	// build a token with its type, text and pos
+	// must use startIndex meaning where the token starts (the quote for strings),
+	// not where the cursor is now
 }
 
 std::vector<Token> Tokeniser::tokenise()
 {
-	while ( m_index < m_source.size() ) {
-		const char c = peek();
-		//* whitespace
-		if ( c == ' ' || c == '\t' || c == '\r' ) {
-			advance();
-			continue;
-			// Ignore 'spaces', 'tabs', 'carriage return'
-			// Just advance and continue.
-			// continue means “I’m DONE handling this character/token.
-			// 						Go back to the top of the loop.”
-			// one could instead write else-ifs but those can be janky for tokenisers
+	if ( m_threads != 1 && m_source.size() >= m_parallelMinBytes ) {
+		return tokeniseParallel();
+	}
+
+	std::vector<Token> tokens;
+	while ( true ) {
+		tokens.push_back( next() );
+		if ( tokens.back().type == TokenType::T_EOF ) {
+			break;
 		}
+	}
+	return tokens;	// return the tokens for further use, such as parsing
+}
+
+/* --------------------------------------------------------------------------------------------- */
+// # Lookup tables
+// every byte maps to a class, and each class has exactly one way of being lexed.
+// plain tables instead of <cctype> calls: no locale, no out-of-line calls, and one jump per token
+
+namespace
+{
+
+enum class CharClass : uint8_t
+{
+	Invalid,	 // not allowed outside strings and comments
+	Space,	 // ' ', '\t', '\r', '\n'
+	Digit,	 // starts a number literal
+	Ident,	 // starts an identifier / keyword (letter or _)
+	Quote,	 // starts a string literal
+	Slash,	 // '/' : a comment or the division operator
+	Operator	 // a symbol listed in g_operators
+};
+
+// what one symbol char can turn into.
+// `single` is the token on its own (T_EOF = not valid alone, like '!'); `second`/`paired` list
+// the chars that can follow it to form a doubled operator
+struct OperatorRule {
+	TokenType single = TokenType::T_EOF;
+	std::array<char, 3> second{};
+	std::array<TokenType, 3> paired{};
+};
+
+constexpr std::array<OperatorRule, 256> makeOperatorTable()
+{
+	std::array<OperatorRule, 256> ops{};
+	const auto set = [ &ops ]( const char c, const OperatorRule rule ) {
+		ops[ static_cast<unsigned char>( c ) ] = rule;
+	};
+	set( '+', { TokenType::T_plus } );
+	set( '-', { TokenType::T_minus } );
+	set( '*', { TokenType::T_star } );
+	set( '/', { TokenType::T_slash } );
+	set( ';', { TokenType::T_semi } );
+	set( ',', { TokenType::T_comma } );
+	set( '(', { TokenType::T_LBrack } );
+	set( ')', { TokenType::T_RBrack } );
+	set( '{', { TokenType::T_LBrace } );
+	set( '}', { TokenType::T_RBrace } );
+	set( '[', { TokenType::T_LSquare } );
+	set( ']', { TokenType::T_RSquare } );
+	// doubled operators ( =< and => are accepted as aliases of <= and >= )
+	set( '=', { TokenType::T_eq,
+					{ '=', '>', '<' },
+					{ TokenType::T_eqEq, TokenType::T_GrTEq, TokenType::T_LeTEq } } );
+	set( '!', { TokenType::T_EOF, { '=' }, { TokenType::T_NotE } } );
+	set( '<', { TokenType::T_LeT, { '=' }, { TokenType::T_LeTEq } } );
+	set( '>', { TokenType::T_GrT, { '=' }, { TokenType::T_GrTEq } } );
+	return ops;
+}
+
+constexpr std::array<OperatorRule, 256> g_operators = makeOperatorTable();
+
+constexpr std::array<CharClass, 256> makeCharClassTable()
+{
+	std::array<CharClass, 256> classes{};	// everything starts as Invalid
+	for ( int c = 0; c < 256; ++c ) {
+		if ( g_operators[ c ].single != TokenType::T_EOF || g_operators[ c ].second[ 0 ] != '\0' ) {
+			classes[ c ] = CharClass::Operator;
+		}
+	}
+	for ( int c = 'a'; c <= 'z'; ++c ) {
+		classes[ c ] = CharClass::Ident;
+		classes[ c - 'a' + 'A' ] = CharClass::Ident;
+	}
+	for ( int c = '0'; c <= '9'; ++c ) {
+		classes[ c ] = CharClass::Digit;
+	}
+	classes[ '_' ] = CharClass::Ident;
+	classes[ '"' ] = CharClass::Quote;
+	classes[ '/' ] = CharClass::Slash;
+	for ( const char c : { ' ', '\t', '\r', '\n' } ) {
+		classes[ static_cast<unsigned char>( c ) ] = CharClass::Space;
+	}
+	return classes;
+}
 
-		//* new line: advance, increment line,reset column, continue
-		if ( c == '\n' ) {
+constexpr std::array<CharClass, 256> g_charClass = makeCharClassTable();
+
+// chars that may continue an identifier (the start is decided by g_charClass)
+constexpr std::array<bool, 256> makeIdentTable()
+{
+	std::array<bool, 256> ident{};
+	for ( int c = 0; c < 256; ++c ) {
+		ident[ c ] = ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' ) ||
+						 c == '_';
+	}
+	return ident;
+}
+
+constexpr std::array<bool, 256> g_identChar = makeIdentTable();
+
+constexpr std::array<bool, 256> makeSingleClassTable( const CharClass cls )
+{
+	std::array<bool, 256> member{};
+	for ( int c = 0; c < 256; ++c ) {
+		member[ c ] = g_charClass[ c ] == cls;
+	}
+	return member;
+}
+
+constexpr std::array<bool, 256> g_digitChar = makeSingleClassTable( CharClass::Digit );
+constexpr std::array<bool, 256> g_spaceChar = makeSingleClassTable( CharClass::Space );
+
+// most runs (names, numbers, the gap between tokens) are only a few chars long, and for those
+// a table walk beats setting up a vector scan. only runs that fill the first 16 bytes are
+// handed over to the SIMD kernel
+const char* scanRun( const char* p, const char* end, const std::array<bool, 256>& member,
+							const char* ( *kernel )( const char*, const char* ) )
+{
+	const char* shortEnd = end - p > 16 ? p + 16 : end;
+	while ( p < shortEnd && member[ static_cast<unsigned char>( *p ) ] ) {
+		++p;
+	}
+	return p == shortEnd && p < end ? kernel( p, end ) : p;
+}
+
+static_assert( g_charClass[ '=' ] == CharClass::Operator && g_charClass[ '!' ] == CharClass::Operator );
+static_assert( g_charClass[ '#' ] == CharClass::Invalid && g_charClass[ 0x80 ] == CharClass::Invalid );
+
+}	// namespace
+
+/* --------------------------------------------------------------------------------------------- */
+
+// lexes one symbol via g_operators; the longest match wins ("==" over "=")
+Token Tokeniser::lexOperator()
+{
+	const size_t startIndex = m_index;
+	const OperatorRule& rule = g_operators[ static_cast<unsigned char>( advance() ) ];
+
+	const char next = peek();
+	for ( size_t i = 0; i < rule.second.size() && rule.second[ i ] != '\0'; ++i ) {
+		if ( rule.second[ i ] == next ) {
 			advance();
-			m_line++;
-			m_column = 1;
-			continue;
+			return makeToken( rule.paired[ i ], m_source.substr( startIndex, 2 ), startIndex );
 		}
+	}
+	if ( rule.single == TokenType::T_EOF ) {
+		throw std::runtime_error( std::string( "Unexpected '" ) + m_source[ startIndex ] + "'" );
+	}
+	return makeToken( rule.single, m_source.substr( startIndex, 1 ), startIndex );
+}
+
+// lexes exactly one token; whitespace and comments are skipped on the way to it.
+// once the end of the input is reached every further call returns T_EOF
+Token Tokeniser::next()
+{
+	while ( m_index < m_source.size() ) {
+		const char c = peek();
+		switch ( g_charClass[ static_cast<unsigned char>( c ) ] ) {
+		//* whitespace (new lines too): skip the whole run in one go
+		case CharClass::Space:
+			advanceTo( scanRun( cursor(), sourceEnd(), g_spaceChar, lexscan::skipWhitespace ) );
+			continue;
+			// Ignore 'spaces', 'tabs', 'carriage return', 'new line'
+			// new lines are nothing special any more: a token only remembers its byte offset
+			// continue means “I’m DONE with these characters, they weren't a token.
+			// 						Go back to the top of the loop.”
 
 		//* numbers
-		if ( std::isdigit( static_cast<unsigned char>( c ) ) ) {	 // detect the start of a num
-			// undefined behavior without static cast
-			const size_t startIndex = m_index;	  // remember where the num start,
-			const size_t startColumn = m_column;  // ''
-			// ↓ consume all digits
-			while ( std::isdigit( static_cast<unsigned char>( peek() ) ) ) {
-				advance();
-			}
+		case CharClass::Digit: {
+			const size_t startIndex = m_index;	// remember where the num start
+			advanceTo( scanRun( cursor(), sourceEnd(), g_digitChar, lexscan::skipDigits ) );
+			// ↑ consume all digits
 
-			addToken( TokenType::T_numLit, m_source.substr( startIndex, m_index - startIndex ),
-						 startColumn );  // extract the num tex ↑
-			continue;
+			return makeToken( TokenType::T_numLit, m_source.substr( startIndex, m_index - startIndex ),
+									startIndex );	// extract the num tex ↑
 		}
 
 		//* ids/keywords
-		if ( std::isalpha( static_cast<unsigned char>( c ) ) || c == '_' ) {
-			// ↑ consume letters , digit and underscores
+		case CharClass::Ident: {
+			// ↓ consume letters , digit and underscores
 			const size_t startIndex = m_index;
-			const size_t startColumn = m_column;
-			while ( std::isalnum( static_cast<unsigned char>( peek() ) ) || peek() == '_' ) {
-				advance();
-			}
-			// if we get non-quoted text the extract it for comparison
-			std::string txt = m_source.substr( startIndex, m_index - startIndex );
-			// if the piece of text matches then add correct token
+			advanceTo( scanRun( cursor(), sourceEnd(), g_identChar, lexscan::skipIdentifier ) );
+			// if we get non-quoted text the extract it for comparison (a view, no copy)
+			const std::string_view txt = m_source.substr( startIndex, m_index - startIndex );
+			// if the piece of text is a keyword then add correct token, otherwise it's an identifier
 			//@ match Tokens
-			if ( auto tryKey = g_keywords.find( txt ); tryKey != g_keywords.end() ) {
-				addToken( tryKey->second, txt, startColumn );
-				// second means the 2nd part of a key of the map
-			} else {
-				addToken( TokenType::T_identifier, txt, startColumn );
+			Token tk = makeToken( keywordType( txt ), txt, startIndex );
+			if ( tk.type == TokenType::T_identifier && m_interner ) {
+				tk.symbol = m_interner->intern( txt );	 // the only time this name is ever hashed
 			}
-			continue;
+			return tk;
 		}
-		// one might wonder why use isalpha in parent if and isalnum in the child
+		// one might wonder why the class table only lets letters/_ start an id but the scan
+		// takes digits too
 		/* In c-like langs
 		the start of a identifier must not be a num
-		the outer condition ensures that
-		and in the inner "if" we're asking "can this char continue the id name"
+		the class table ensures that
+		and the scan is asking "can this char continue the id name"
 		*/
 
 		//* string literals
-		if ( c == '"' ) {
-			const size_t startColumn = m_column;
+		case CharClass::Quote: {
+			const size_t quoteIndex = m_index;	// the token starts at the quote
 			advance();									// consume opening quote
 			const size_t startIndex = m_index;	// define startIndex where the string actually starts
 
-			while ( peek() != '"' && peek() != '\0' ) {	// look ahead without moving
-				if ( peek() == '\n' ) {
-					throw std::runtime_error( "Unterminated string literal" );	// error if newline
-				}
-				advance();	// keep consuming chars until we reach char before either " or \0
-			}
-			if ( peek() == '\0' ) {	 // checks the next char
+			// jump to the closing quote, or to the new line / \0 that comes before it
+			const char* stop = lexscan::findStringEnd( cursor(), sourceEnd() );
+			advanceTo( stop );
+			if ( stop == sourceEnd() || *stop != '"' ) {
 				throw std::runtime_error( "Unterminated string literal" );
-				// If the loop finishes because it hit the end of the file (\0) rather than a closing
-				// quote, it’s a syntax error.
+				// a new line, or the end of the file (\0) before the closing quote: syntax error
 			}	// if this doesn't trigger the next char is "
-			const std::string value = m_source.substr( startIndex, m_index - startIndex );
+			const std::string_view value = m_source.substr( startIndex, m_index - startIndex );
 			advance();	// consume closing "
 
-			addToken( TokenType::T_strLit, value, startColumn );
-			continue;
+			return makeToken( TokenType::T_strLit, value, quoteIndex );
 		}
 
-		// here we compare chars for token assignment
-		// {} bcs of needing to define startcolumn per case
-		switch ( c ) {
-		case '+': {
-			const size_t startColumn = m_column;
-			advance();
-			addToken( TokenType::T_plus, "+", startColumn );
-			break;
-		}
-		case '-': {
-			const size_t startColumn = m_column;
-			advance();
-			addToken( TokenType::T_minus, "-", startColumn );
-			break;
-		}
-		case '*': {
-			const size_t startColumn = m_column;
-			advance();
-			addToken( TokenType::T_star, "*", startColumn );
-			break;
-		}
-		case '/': {
-			const size_t startColumn = m_column;
-			advance();
-			if ( peek() == '/' ) {
-				// single line
-				while ( peek() != '\n' && peek() != '\0' ) {
-					advance();
-				}
-			} else if ( peek() == '*' ) {
+		//* comments, or plain division
+		case CharClass::Slash: {
+			const char after = m_index + 1 < m_source.size() ? m_source[ m_index + 1 ] : '\0';
+			if ( after == '/' ) {
+				// single line: everything up to (not including) the new line
+				advanceTo( lexscan::findLineEnd( cursor(), sourceEnd() ) );
+				continue;	// a comment isn't a token, keep looking
+			}
+			if ( after == '*' ) {
 				// multiline
 				advance();
-				while ( true ) {
-					if ( peek() == '\0' ) {
-						throw std::runtime_error( "Unterminated comment" );
-					}
-					if ( peek() == '*' && m_source[ m_index + 1 ] == '/' ) {
-						advance();
-						advance();
-						break;
-					}
-					if ( peek() == '\n' ) {
-						m_line++;
-						m_column = 1;
+				advance();
+				const char* close = lexscan::findBlockCommentEnd( cursor(), sourceEnd() );
+				if ( close == sourceEnd() ) {
+					if ( m_isSlice ) {
+						// the next slice decides whether the comment is closed
+						advanceTo( sourceEnd() );
+						m_endsInComment = true;
+						continue;
 					}
-					advance();
+					throw std::runtime_error( "Unterminated comment" );
 				}
-
-			} else {
-
-				addToken( TokenType::T_slash, "/", startColumn );
+				advanceTo( close + 2 );	 // past the */
+				continue;
 			}
-			break;
+			return lexOperator();
 		}
-		case ';': {
-			const size_t startColumn = m_column;
-			advance();
-			addToken( TokenType::T_semi, ";", startColumn );
-			break;
-		}
-		case '(': {
-			const size_t startColumn = m_column;
-			advance();
-			addToken( TokenType::T_LBrack, "(", startColumn );
-			break;
-		}
-		case ')': {
-			const size_t startColumn = m_column;
-			advance();
-			addToken( TokenType::T_RBrack, ")", startColumn );
-			break;
-		}
-		case '{': {
-			const size_t startColumn = m_column;
-			advance();
-			addToken( TokenType::T_LBrace, "{", startColumn );
-			break;
-		}
-		case '}': {
-			const size_t startColumn = m_column;
-			advance();
-			addToken( TokenType::T_RBrace, "}", startColumn );
-			break;
-		}
-		case '[': {
-			const size_t startColumn = m_column;
-			advance();
-			addToken( TokenType::T_LSquare, "[", startColumn );
-			break;
-		}
-		case ']': {
-			const size_t startColumn = m_column;
-			advance();
-			addToken( TokenType::T_RSquare, "]", startColumn );
-			break;
-		}
-		case ',': {
-			const size_t startColumn = m_column;
-			advance();
-			addToken( TokenType::T_comma, ",", startColumn );
-			break;
-		}
-		case '=': {
-			const size_t startColumn = m_column;
-			advance();
-			if ( peek() == '=' ) {
-				advance();
-				addToken( TokenType::T_eqEq, "==", startColumn );
-			} else if ( peek() == '>' ) {
-				advance();
-				addToken( TokenType::T_GrTEq, "=>", startColumn );
-			} else if ( peek() == '<' ) {
-				advance();
-				addToken( TokenType::T_LeTEq, "=<", startColumn );
-			} else {
-				addToken( TokenType::T_eq, "=", startColumn );
-			}
-			break;
-		}
-		case '!': {
-			const size_t startColumn = m_column;
-			advance();
-			if ( peek() == '=' ) {
-				advance();
-				addToken( TokenType::T_NotE, "!=", startColumn );
-			} else {
-				throw std::runtime_error( "Unexpected '!'" );
-			}
-			break;
-		}
-		case '<': {
-			const size_t startColumn = m_column;
-			advance();
-			if ( peek() == '=' ) {
-				advance();
-				addToken( TokenType::T_LeTEq, "<=", startColumn );
-			} else {
-				addToken( TokenType::T_LeT, "<", startColumn );
-			}
-			break;
-		}
-		case '>': {
-			const size_t startColumn = m_column;
-			advance();
-			if ( peek() == '=' ) {
-				advance();
-				addToken( TokenType::T_GrTEq, ">=", startColumn );
-			} else {
-				addToken( TokenType::T_GrT, ">", startColumn );
-			}
+
+		//* symbols, looked up in g_operators
+		case CharClass::Operator:
+			return lexOperator();
+
+		case CharClass::Invalid:
 			break;
 		}
-		default:
-			// for now crashes if a symbol doesn't match (lose text etc. becomes ids)
-			throw std::runtime_error( "Unknown character at " + std::to_string( m_line ) + ":" +
-											  std::to_string( m_column ) );
-		}
+		// for now crashes if a symbol doesn't match (lose text etc. becomes ids)
+		// the only place the lexer needs a line number, so only here are the lines counted
+		const LineColumn pos = LineTable( m_source ).resolve( { static_cast<uint32_t>( m_index ) } );
+		throw std::runtime_error( "Unknown character at " + std::to_string( pos.line ) + ":" +
+										  std::to_string( pos.column ) );
 	}
 
-	addToken( TokenType::T_EOF, "", m_column );	// end of file
-	return m_tokens;	// return the tokens for further use, such as parsing
+	return makeToken( TokenType::T_EOF, "", m_index );	// end of file
 }
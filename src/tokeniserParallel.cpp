@@ -0,0 +1,163 @@
+// src\tokeniserParallel.cpp
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "headers/lexScan.hpp"
+#include "headers/tokeniser.hpp"
+
+/* How the parallel path works
+
+1. cut the source into slices that each start at the beginning of a line
+2. lex every slice (in parallel) as if it started outside of any comment. Locations are byte
+	offsets into the whole file, so a slice needs nothing from the ones before it
+3. walk the slices in order: a slice that really starts inside a block comment (the previous one
+	ended with the comment still open) is lexed again from its closing star-slash, then the tokens
+	are joined
+4. intern the identifiers, which has to be in order (and on one thread) to keep ids dense
+
+Strings and line comments can't cross a new line, so an open block comment is the only state
+that can leak from one slice into the next. Errors are kept per slice and only thrown once the
+slice is known to have been lexed from the right state, so the first error is the serial one.
+*/
+
+/* --------------------------------------------------------------------------------------------- */
+
+namespace
+{
+
+struct SliceResult {
+	std::vector<Token> tokens;	 // without the T_EOF
+	Token eof{};					 // where the slice ended
+	bool endsInComment = false;
+	std::exception_ptr error;
+};
+
+// runs fn(0) .. fn(count - 1) on up to `threads` threads, handing out indices as they free up
+template <typename Fn>
+void parallelFor( const size_t count, const unsigned threads, Fn fn )
+{
+	std::atomic<size_t> nextIndex{ 0 };
+	const auto worker = [ & ] {
+		for ( size_t i = nextIndex++; i < count; i = nextIndex++ ) {
+			fn( i );
+		}
+	};
+
+	std::vector<std::jthread> pool;
+	const size_t extra = std::min<size_t>( threads, count ) - 1;	// this thread works too
+	pool.reserve( extra );
+	for ( size_t t = 0; t < extra; ++t ) {
+		pool.emplace_back( worker );
+	}
+	worker();
+}	// jthreads join here
+
+}	// namespace
+
+/* --------------------------------------------------------------------------------------------- */
+
+Tokeniser::Tokeniser( const std::string_view source, const size_t begin, const size_t end )
+	 : m_source( source.substr( 0, end ) ), m_index( begin ), m_isSlice( true )
+{
+	// the text before `begin` stays in view, so an error can still count lines from the top
+}
+
+void Tokeniser::setParallel( const unsigned threads, const size_t minBytes )
+{
+	m_threads = threads != 0 ? threads : std::max( 1u, std::thread::hardware_concurrency() );
+	m_parallelMinBytes = minBytes;
+}
+
+void Tokeniser::skipOpenComment()
+{
+	const char* close = lexscan::findBlockCommentEnd( cursor(), sourceEnd() );
+	if ( close == sourceEnd() ) {
+		advanceTo( sourceEnd() );	// the whole slice is comment
+		m_endsInComment = true;
+		return;
+	}
+	advanceTo( close + 2 );
+}
+
+std::vector<Token> Tokeniser::tokeniseParallel()
+{
+	const char* begin = m_source.data();
+	const char* end = sourceEnd();
+
+	// # 1. slice boundaries, a few slices per thread so uneven slices balance out
+	const size_t wanted = static_cast<size_t>( m_threads ) * 4;
+	std::vector<size_t> starts{ 0 };
+	for ( size_t k = 1; k < wanted; ++k ) {
+		const size_t target = std::max( m_source.size() * k / wanted, starts.back() );
+		const char* newLine = lexscan::findLineEnd( begin + target, end );
+		if ( newLine == end || newLine + 1 == end ) {
+			break;
+		}
+		const auto start = static_cast<size_t>( newLine + 1 - begin );
+		if ( start > starts.back() ) {
+			starts.push_back( start );
+		}
+	}
+	const size_t sliceCount = starts.size();
+	starts.push_back( m_source.size() );
+
+	// # 2. lex every slice as if it started outside a comment
+	const auto lexSlice = [ & ]( const size_t i, const bool startsInComment ) {
+		SliceResult result;
+		Tokeniser lexer( m_source, starts[ i ], starts[ i + 1 ] );
+		try {
+			if ( startsInComment ) {
+				lexer.skipOpenComment();
+			}
+			for ( Token tk = lexer.next(); tk.type != TokenType::T_EOF; tk = lexer.next() ) {
+				result.tokens.push_back( tk );
+			}
+			result.eof = lexer.next();
+		} catch ( ... ) {
+			result.error = std::current_exception();
+		}
+		result.endsInComment = lexer.m_endsInComment;
+		return result;
+	};
+
+	std::vector<SliceResult> results( sliceCount );
+	parallelFor( sliceCount, m_threads,
+					 [ & ]( const size_t i ) { results[ i ] = lexSlice( i, false ); } );
+
+	// # 3. fix up slices that start inside a comment, then join in order
+	size_t total = 0;
+	for ( const SliceResult& r : results ) {
+		total += r.tokens.size();
+	}
+	std::vector<Token> tokens;
+	tokens.reserve( total + 1 );
+
+	bool inComment = false;
+	for ( size_t i = 0; i < sliceCount; ++i ) {
+		if ( inComment ) {
+			results[ i ] = lexSlice( i, true );	 // the guess was wrong, redo it past the comment
+		}
+		if ( results[ i ].error ) {
+			std::rethrow_exception( results[ i ].error );
+		}
+		tokens.insert( tokens.end(), results[ i ].tokens.begin(), results[ i ].tokens.end() );
+		inComment = results[ i ].endsInComment;
+	}
+	if ( inComment ) {
+		throw std::runtime_error( "Unterminated comment" );
+	}
+
+	tokens.push_back( results.back().eof );  // end of file, where the last slice ended
+
+	// # 4. intern in source order, so ids come out exactly as the serial lexer numbers them
+	for ( Token& tk : tokens ) {
+		if ( tk.type == TokenType::T_identifier ) {
+			tk.symbol = m_interner->intern( tk.value );
+		}
+	}
+	return tokens;
+}